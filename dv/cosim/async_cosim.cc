@@ -0,0 +1,269 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "async_cosim.h"
+
+#include <cassert>
+
+// Number of times to poll the ring before yielding the CPU when waiting on the
+// other thread. Waits are expected to be short so spinning briefly avoids the
+// cost of a context switch.
+static const int kSpinsBeforeYield = 64;
+
+static void backoff(int &spins) {
+  if (++spins >= kSpinsBeforeYield) {
+    std::this_thread::yield();
+    spins = 0;
+  }
+}
+
+AsyncCosim::AsyncCosim(std::unique_ptr<Cosim> cosim, size_t ring_size)
+    : cosim(std::move(cosim)),
+      ring_head(0),
+      ring_tail(0),
+      failed_steps(0),
+      reported_failed_steps(0),
+      stop_worker(false) {
+  assert(this->cosim);
+  assert(ring_size != 0);
+
+  size_t size = 1;
+  while (size < ring_size) {
+    size <<= 1;
+  }
+
+  ring.resize(size);
+  ring_mask = size - 1;
+
+  worker = std::thread(&AsyncCosim::worker_loop, this);
+}
+
+AsyncCosim::~AsyncCosim() {
+  drain();
+
+  stop_worker.store(true, std::memory_order_release);
+  worker.join();
+}
+
+Cosim *AsyncCosim::get_wrapped() {
+  drain();
+
+  return cosim.get();
+}
+
+void AsyncCosim::push_event(const CosimEvent &event) {
+  size_t tail = ring_tail.load(std::memory_order_relaxed);
+
+  int spins = 0;
+  while (tail - ring_head.load(std::memory_order_acquire) == ring.size()) {
+    backoff(spins);
+  }
+
+  ring[tail & ring_mask] = event;
+  ring_tail.store(tail + 1, std::memory_order_release);
+}
+
+void AsyncCosim::drain() {
+  size_t tail = ring_tail.load(std::memory_order_relaxed);
+
+  int spins = 0;
+  while (ring_head.load(std::memory_order_acquire) != tail) {
+    backoff(spins);
+  }
+}
+
+unsigned int AsyncCosim::take_unreported_failed_steps() {
+  drain();
+
+  unsigned int unreported =
+      failed_steps.load(std::memory_order_acquire) - reported_failed_steps;
+  reported_failed_steps += unreported;
+
+  return unreported;
+}
+
+bool AsyncCosim::take_failed_step() {
+  if (failed_steps.load(std::memory_order_acquire) == reported_failed_steps) {
+    return false;
+  }
+
+  ++reported_failed_steps;
+  return true;
+}
+
+void AsyncCosim::worker_loop() {
+  size_t head = ring_head.load(std::memory_order_relaxed);
+
+  int spins = 0;
+  while (true) {
+    if (ring_tail.load(std::memory_order_acquire) == head) {
+      if (stop_worker.load(std::memory_order_acquire)) {
+        return;
+      }
+
+      backoff(spins);
+      continue;
+    }
+
+    spins = 0;
+
+    size_t mismatch_idx;
+    if (!cosim->step_batch(&ring[head & ring_mask], 1, mismatch_idx)) {
+      failed_steps.fetch_add(1, std::memory_order_release);
+    }
+
+    ++head;
+    ring_head.store(head, std::memory_order_release);
+  }
+}
+
+void AsyncCosim::add_memory(uint32_t base_addr, size_t size) {
+  drain();
+  cosim->add_memory(base_addr, size);
+}
+
+bool AsyncCosim::backdoor_write_mem(uint32_t addr, size_t len,
+                                    const uint8_t *data_in) {
+  drain();
+  return cosim->backdoor_write_mem(addr, len, data_in);
+}
+
+bool AsyncCosim::backdoor_read_mem(uint32_t addr, size_t len,
+                                   uint8_t *data_out) {
+  drain();
+  return cosim->backdoor_read_mem(addr, len, data_out);
+}
+
+bool AsyncCosim::step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
+                      bool sync_trap, bool suppress_reg_write) {
+  CosimEvent event;
+  event.type = kCosimEventStep;
+  event.step.write_reg = write_reg;
+  event.step.write_reg_data = write_reg_data;
+  event.step.pc = pc;
+  event.step.sync_trap = sync_trap;
+  event.step.suppress_reg_write = suppress_reg_write;
+  push_event(event);
+
+  return !take_failed_step();
+}
+
+bool AsyncCosim::step_batch(const CosimEvent *events, size_t num_events,
+                            size_t &mismatch_idx) {
+  for (size_t i = 0; i < num_events; ++i) {
+    push_event(events[i]);
+
+    if ((events[i].type == kCosimEventStep) && take_failed_step()) {
+      mismatch_idx = i;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void AsyncCosim::set_mip(uint32_t pre_mip, uint32_t post_mip) {
+  CosimEvent event;
+  event.type = kCosimEventMip;
+  event.mip.pre_mip = pre_mip;
+  event.mip.post_mip = post_mip;
+  push_event(event);
+}
+
+void AsyncCosim::set_nmi(bool nmi) {
+  CosimEvent event;
+  event.type = kCosimEventNmi;
+  event.level = nmi;
+  push_event(event);
+}
+
+void AsyncCosim::set_nmi_int(bool nmi_int) {
+  CosimEvent event;
+  event.type = kCosimEventNmiInt;
+  event.level = nmi_int;
+  push_event(event);
+}
+
+void AsyncCosim::set_debug_req(bool debug_req) {
+  CosimEvent event;
+  event.type = kCosimEventDebugReq;
+  event.level = debug_req;
+  push_event(event);
+}
+
+void AsyncCosim::set_mcycle(uint64_t mcycle) {
+  CosimEvent event;
+  event.type = kCosimEventMcycle;
+  event.mcycle = mcycle;
+  push_event(event);
+}
+
+void AsyncCosim::set_csr(const int csr_num, const uint32_t new_val) {
+  CosimEvent event;
+  event.type = kCosimEventCsr;
+  event.csr.csr_num = csr_num;
+  event.csr.val = new_val;
+  push_event(event);
+}
+
+void AsyncCosim::set_ic_scr_key_valid(bool valid) {
+  CosimEvent event;
+  event.type = kCosimEventIcScrKeyValid;
+  event.level = valid;
+  push_event(event);
+}
+
+void AsyncCosim::notify_dside_access(const DSideAccessInfo &access_info) {
+  CosimEvent event;
+  event.type = kCosimEventDSideAccess;
+  event.dside_access = access_info;
+  push_event(event);
+}
+
+void AsyncCosim::set_iside_error(uint32_t addr) {
+  CosimEvent event;
+  event.type = kCosimEventISideError;
+  event.iside_err_addr = addr;
+  push_event(event);
+}
+
+const std::vector<CosimMismatch> &AsyncCosim::get_mismatches() {
+  drain();
+  return cosim->get_mismatches();
+}
+
+const std::vector<std::string> &AsyncCosim::get_errors() {
+  drain();
+  return cosim->get_errors();
+}
+
+void AsyncCosim::clear_errors() {
+  drain();
+  cosim->clear_errors();
+}
+
+unsigned int AsyncCosim::get_insn_cnt() {
+  drain();
+  return cosim->get_insn_cnt();
+}
+
+std::unique_ptr<CosimState> AsyncCosim::save_state() {
+  drain();
+  return cosim->save_state();
+}
+
+bool AsyncCosim::restore_state(const CosimState &state) {
+  drain();
+  return cosim->restore_state(state);
+}
+
+bool AsyncCosim::write_state(const CosimState &state, std::ostream &out) {
+  drain();
+  return cosim->write_state(state, out);
+}
+
+std::unique_ptr<CosimState> AsyncCosim::read_state(std::istream &in) {
+  drain();
+  return cosim->read_state(in);
+}
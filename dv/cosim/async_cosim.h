@@ -0,0 +1,112 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef ASYNC_COSIM_H_
+#define ASYNC_COSIM_H_
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cosim.h"
+
+// A `Cosim` that runs another `Cosim` on a separate thread.
+//
+// Calls that feed the co-simulator (`step`, `notify_dside_access`, `set_mip`
+// etc) are turned into `CosimEvent`s and pushed into a single-producer,
+// single-consumer ring buffer. A worker thread pops events from the ring and
+// applies them to the wrapped co-simulator, so the simulation environment can
+// carry on simulating the DUT whilst the co-simulator catches up.
+//
+// As checking happens later, a `step` returning true does not mean that
+// instruction matched. When the worker sees a step fail, the next `step` (or
+// `step_batch`) call made by the environment returns false. Each failing step
+// is reported once. The worker can never be more than the ring capacity behind
+// (the producer waits when the ring is full) so a mismatch is reported within a
+// bounded number of events.
+//
+// All other calls (backdoor memory accesses, `get_errors`, `get_insn_cnt`
+// etc) first wait for the worker to process every queued event, so they see
+// exactly what they would have seen from a synchronous co-simulator.
+//
+// All calls must be made from a single thread.
+class AsyncCosim : public Cosim {
+ public:
+  // Takes ownership of `cosim`. `ring_size` is the number of events that can
+  // be queued, it is rounded up to a power of two.
+  AsyncCosim(std::unique_ptr<Cosim> cosim, size_t ring_size = 4096);
+  ~AsyncCosim();
+
+  // Wait for all queued events to be processed and return the wrapped
+  // co-simulator so it can be accessed directly (e.g. for functionality not
+  // in the `Cosim` interface).
+  Cosim *get_wrapped();
+
+  // Wait for all queued events to be processed and return the number of
+  // failed steps that haven't been reported by `step` or `step_batch`. Call
+  // this at the end of simulation to catch mismatches in the final events.
+  // Returned failures count as reported.
+  unsigned int take_unreported_failed_steps();
+
+  // Cosim implementation
+  void add_memory(uint32_t base_addr, size_t size) override;
+  bool backdoor_write_mem(uint32_t addr, size_t len,
+                          const uint8_t *data_in) override;
+  bool backdoor_read_mem(uint32_t addr, size_t len, uint8_t *data_out) override;
+  bool step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
+            bool sync_trap, bool suppress_reg_write) override;
+  // Where a mismatch is reported `mismatch_idx` gives the event at which it
+  // was noticed, not the event that caused it.
+  bool step_batch(const CosimEvent *events, size_t num_events,
+                  size_t &mismatch_idx) override;
+  void set_mip(uint32_t pre_mip, uint32_t post_mip) override;
+  void set_nmi(bool nmi) override;
+  void set_nmi_int(bool nmi_int) override;
+  void set_debug_req(bool debug_req) override;
+  void set_mcycle(uint64_t mcycle) override;
+  void set_csr(const int csr_num, const uint32_t new_val) override;
+  void set_ic_scr_key_valid(bool valid) override;
+  void notify_dside_access(const DSideAccessInfo &access_info) override;
+  void set_iside_error(uint32_t addr) override;
+  const std::vector<CosimMismatch> &get_mismatches() override;
+  const std::vector<std::string> &get_errors() override;
+  void clear_errors() override;
+  unsigned int get_insn_cnt() override;
+  std::unique_ptr<CosimState> save_state() override;
+  bool restore_state(const CosimState &state) override;
+  bool write_state(const CosimState &state, std::ostream &out) override;
+  std::unique_ptr<CosimState> read_state(std::istream &in) override;
+
+ private:
+  std::unique_ptr<Cosim> cosim;
+
+  std::vector<CosimEvent> ring;
+  size_t ring_mask;
+
+  // Index of the next event the worker will process and the next free slot
+  // in the ring respectively. Both only ever increase, the ring index is
+  // taken modulo the ring size. `ring_head` is only written by the worker and
+  // `ring_tail` only by the producer.
+  std::atomic<size_t> ring_head;
+  std::atomic<size_t> ring_tail;
+
+  // Number of steps the worker has seen fail and the number of those that
+  // have been reported back from `step`.
+  std::atomic<unsigned int> failed_steps;
+  unsigned int reported_failed_steps;
+
+  std::atomic<bool> stop_worker;
+  std::thread worker;
+
+  void push_event(const CosimEvent &event);
+  // Wait until the worker has processed all queued events
+  void drain();
+  // Returns true (once) for each failed step not yet reported
+  bool take_failed_step();
+
+  void worker_loop();
+};
+
+#endif  // ASYNC_COSIM_H_
@@ -0,0 +1,131 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "cosim.h"
+
+#include <cassert>
+#include <sstream>
+
+static const char *access_str(bool store) { return store ? "store" : "load"; }
+
+std::string CosimMismatch::to_string() const {
+  std::stringstream err_str;
+
+  switch (kind) {
+    case kCosimMismatchSyncTrapNotSeen:
+      err_str << "Synchronous trap was expected at ISS PC: " << std::hex
+              << iss_pc << " but the DUT didn't report one at PC " << dut_pc;
+      break;
+    case kCosimMismatchISideErrorNotSeen:
+      err_str << "DUT generated an iside error for address: " << std::hex
+              << addr << " but the ISS didn't produce one";
+      break;
+    case kCosimMismatchPc:
+      err_str << "PC mismatch, DUT retired : " << std::hex << dut_pc
+              << " , but the ISS retired: " << iss_pc;
+      break;
+    case kCosimMismatchUnexpectedRegWrite:
+      err_str << "DUT wrote register x" << reg
+              << " but a write was not expected";
+      break;
+    case kCosimMismatchSyncTrapPc:
+      err_str << "PC mismatch at synchronous trap, DUT at pc: " << std::hex
+              << dut_pc << " while ISS pc is at : " << iss_pc;
+      break;
+    case kCosimMismatchSyncTrapRegWrite:
+      err_str << "Synchronous trap occurred at PC: " << std::hex << dut_pc
+              << " but DUT wrote to register: x" << std::dec << reg;
+      break;
+    case kCosimMismatchMissingRegWrite:
+      err_str << "DUT didn't write to register x" << reg
+              << ", but a write was expected";
+      break;
+    case kCosimMismatchRegIndex:
+      err_str << "Register write index mismatch, DUT: x" << actual
+              << " expected: x" << expected;
+      break;
+    case kCosimMismatchRegData:
+      err_str << "Register write data mismatch to x" << reg
+              << " DUT: " << std::hex << actual << " expected: " << expected;
+      break;
+    case kCosimMismatchSuppressedRegWrite:
+      err_str << "Instruction at " << std::hex << dut_pc
+              << " indicated a suppressed register write but wrote to x"
+              << std::dec << reg;
+      break;
+    case kCosimMismatchSuppressedNotLoad:
+      err_str << "Instruction at " << std::hex << dut_pc
+              << " indicated a suppressed register write is it not a load"
+                 " only loads can suppress register writes";
+      break;
+    case kCosimMismatchInterruptStep:
+      err_str << "Attempted step for interrupt, expecting no instruction would "
+              << "be executed but saw one. PC before: " << std::hex
+              << expected << " PC after: " << actual;
+      break;
+    case kCosimMismatchMisalignedPmp:
+      err_str << "Saw second half of a misaligned access which not have "
+              << "generated a memory request as it does not pass a PMP check,"
+              << " address: " << std::hex << addr;
+      break;
+    case kCosimMismatchMemNoPendingAccess:
+      err_str << "A " << access_str(store) << " at address " << std::hex
+              << addr << " was expected but there are no pending accesses";
+      break;
+    case kCosimMismatchMemAddr:
+      err_str << "DUT generated " << access_str(dut_store) << " at address "
+              << std::hex << actual << " but " << access_str(store)
+              << " at address " << expected << " was expected";
+      break;
+    case kCosimMismatchMemType:
+      err_str << "DUT generated " << access_str(dut_store) << " at addr "
+              << std::hex << addr << " but a " << access_str(store)
+              << " was expected";
+      break;
+    case kCosimMismatchMemBeRepeated:
+      err_str << "DUT generated " << access_str(dut_store) << " at address "
+              << std::hex << addr << " with BE " << actual
+              << " and expected BE " << expected
+              << " has been seen twice, so far seen " << be_mask;
+      break;
+    case kCosimMismatchMemBeExtra:
+      err_str << "DUT generated " << access_str(dut_store) << " at address "
+              << std::hex << addr << " with BE " << actual
+              << " but expected BE " << expected << " has other bytes enabled";
+      break;
+    case kCosimMismatchMemBe:
+      err_str << "DUT generated " << access_str(dut_store) << " at address "
+              << std::hex << addr << " with BE " << actual << " but BE "
+              << expected << " was expected";
+      break;
+    case kCosimMismatchMemData:
+      err_str << "DUT generated " << access_str(store) << " at address "
+              << std::hex << addr << " with data " << actual << " but data "
+              << expected << " was expected with byte mask " << be_mask;
+      break;
+    case kCosimMismatchMisalignedSecondMissing:
+      err_str << "DUT generated first half of misaligned " << access_str(store)
+              << " at address " << std::hex << addr
+              << " but second half was expected and not seen";
+      break;
+    case kCosimMismatchMisalignedSecondAddr:
+      err_str << "DUT generated first half of misaligned " << access_str(store)
+              << " at address " << std::hex << addr
+              << " but second half had incorrect address " << actual;
+      break;
+    case kCosimMismatchEbreakRegWrite:
+      err_str << "DUT executed ebreak at " << std::hex << dut_pc
+              << " but also wrote register x" << std::dec << reg
+              << " which was unexpected";
+      break;
+    case kCosimMismatchEbreakSyncTrap:
+      err_str << "DUT executed ebreak into debug at " << std::hex << dut_pc
+              << " but indicated a synchronous trap, which was unexpected";
+      break;
+    default:
+      assert(false);
+  }
+
+  return err_str.str();
+}
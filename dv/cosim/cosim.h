@@ -2,6 +2,8 @@
 // Licensed under the Apache License, Version 2.0, see LICENSE for details.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <iosfwd>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -41,6 +43,154 @@ struct DSideAccessInfo {
   bool m_mode_access;
 };
 
+// The kinds of event that can be replayed by `Cosim::step_batch`. Each kind
+// corresponds to one of the `Cosim` methods below.
+enum CosimEventType {
+  kCosimEventStep,
+  kCosimEventDSideAccess,
+  kCosimEventMip,
+  kCosimEventNmi,
+  kCosimEventNmiInt,
+  kCosimEventDebugReq,
+  kCosimEventMcycle,
+  kCosimEventCsr,
+  kCosimEventIcScrKeyValid,
+  kCosimEventISideError
+};
+
+// Arguments of a single `Cosim::step` call
+struct CosimStepInfo {
+  uint32_t write_reg;
+  uint32_t write_reg_data;
+  uint32_t pc;
+  bool sync_trap;
+  bool suppress_reg_write;
+};
+
+// A single call into the co-simulator, recorded so a sequence of them can be
+// handed over in one go. Only the member of the union matching `type` is
+// valid.
+struct CosimEvent {
+  CosimEventType type;
+
+  union {
+    // kCosimEventStep
+    CosimStepInfo step;
+    // kCosimEventDSideAccess
+    DSideAccessInfo dside_access;
+    // kCosimEventMip
+    struct {
+      uint32_t pre_mip;
+      uint32_t post_mip;
+    } mip;
+    // kCosimEventNmi, kCosimEventNmiInt, kCosimEventDebugReq and
+    // kCosimEventIcScrKeyValid
+    bool level;
+    // kCosimEventMcycle
+    uint64_t mcycle;
+    // kCosimEventCsr
+    struct {
+      int csr_num;
+      uint32_t val;
+    } csr;
+    // kCosimEventISideError
+    uint32_t iside_err_addr;
+  };
+};
+
+// The kinds of mismatch between the DUT and the co-simulator that can be
+// reported in a `CosimMismatch`.
+enum CosimMismatchKind {
+  // The ISS took a synchronous trap at `iss_pc` but the DUT retired the
+  // instruction at `dut_pc` without one
+  kCosimMismatchSyncTrapNotSeen,
+  // The DUT saw an iside error at `addr` but the ISS didn't
+  kCosimMismatchISideErrorNotSeen,
+  // The DUT retired `dut_pc` but the ISS retired `iss_pc`
+  kCosimMismatchPc,
+  // The DUT wrote register `reg` but the ISS didn't write a register
+  kCosimMismatchUnexpectedRegWrite,
+  // The DUT took a synchronous trap at `dut_pc` but the ISS at `iss_pc`
+  kCosimMismatchSyncTrapPc,
+  // The DUT took a synchronous trap at `dut_pc` but wrote register `reg`
+  kCosimMismatchSyncTrapRegWrite,
+  // The ISS wrote register `reg` but the DUT didn't write a register
+  kCosimMismatchMissingRegWrite,
+  // The DUT wrote register `actual` but the ISS wrote register `expected`
+  kCosimMismatchRegIndex,
+  // The DUT wrote `actual` to register `reg` but the ISS wrote `expected`
+  kCosimMismatchRegData,
+  // The instruction at `dut_pc` suppressed its register write but the DUT
+  // wrote register `reg`
+  kCosimMismatchSuppressedRegWrite,
+  // The instruction at `dut_pc` suppressed its register write but isn't a load
+  kCosimMismatchSuppressedNotLoad,
+  // An ISS step expected to only take an interrupt executed an instruction,
+  // moving the ISS PC from `expected` to `actual`
+  kCosimMismatchInterruptStep,
+  // The DUT produced the second half of a misaligned access to `addr` which
+  // fails PMP checks
+  kCosimMismatchMisalignedPmp,
+  // The ISS accessed `addr` but there was no DUT access to check against
+  kCosimMismatchMemNoPendingAccess,
+  // The DUT accessed address `actual` but the ISS accessed `expected`
+  kCosimMismatchMemAddr,
+  // The DUT and ISS disagree on whether the access to `addr` is a store
+  kCosimMismatchMemType,
+  // Bytes `expected` of the DUT access to `addr` with byte enables `actual`
+  // have already been accessed by the ISS (which has accessed `be_mask` so far)
+  kCosimMismatchMemBeRepeated,
+  // The ISS accessed bytes `expected` which are outside the byte enables
+  // `actual` of the DUT access to `addr`
+  kCosimMismatchMemBeExtra,
+  // The DUT access to `addr` had byte enables `actual` but the ISS accessed
+  // bytes `expected`
+  kCosimMismatchMemBe,
+  // The DUT access to `addr` had data `actual` but the ISS expected `expected`
+  // for the bytes in `be_mask`
+  kCosimMismatchMemData,
+  // The DUT produced the first half of a misaligned access to `addr` with an
+  // error but no second half
+  kCosimMismatchMisalignedSecondMissing,
+  // The DUT produced the first half of a misaligned access to `addr` with an
+  // error and the second half to `actual` rather than the next word
+  kCosimMismatchMisalignedSecondAddr,
+  // The DUT executed a debug ebreak at `dut_pc` but wrote register `reg`
+  kCosimMismatchEbreakRegWrite,
+  // The DUT executed a debug ebreak at `dut_pc` but reported a synchronous trap
+  kCosimMismatchEbreakSyncTrap
+};
+
+// A mismatch between the DUT and the co-simulator.
+//
+// Mismatches are recorded as plain data so that nothing needs to be allocated
+// or formatted whilst checking, use `to_string` to get a human readable
+// description. Which fields are meaningful depends upon `kind` (see
+// `CosimMismatchKind`), the others are zero.
+struct CosimMismatch {
+  CosimMismatchKind kind;
+  uint32_t dut_pc;
+  uint32_t iss_pc;
+  uint32_t reg;
+  uint32_t addr;
+  uint32_t expected;
+  uint32_t actual;
+  uint32_t be_mask;
+  // For memory access mismatches, whether the ISS and the DUT access
+  // respectively are a store
+  bool store;
+  bool dut_store;
+
+  std::string to_string() const;
+};
+
+// Saved co-simulator state, see `Cosim::save_state`. Only meaningful to the
+// `Cosim` implementation that created it.
+class CosimState {
+ public:
+  virtual ~CosimState() {}
+};
+
 class Cosim {
  public:
   virtual ~Cosim() {}
@@ -78,6 +228,20 @@ class Cosim {
   virtual bool step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
                     bool sync_trap, bool suppress_reg_write) = 0;
 
+  // Replay a sequence of events against the co-simulator.
+  //
+  // Each event is applied in order exactly as if the corresponding method
+  // (`step`, `notify_dside_access`, `set_mip` etc) had been called directly.
+  // This allows a simulation environment to buffer many retired instructions
+  // and associated events and hand them over in a single call.
+  //
+  // Replay stops at the first `step` event that fails. In that case false is
+  // returned and `mismatch_idx` is set to the index of the failing event; use
+  // `get_errors` to obtain details. Events after the failing one are not
+  // applied. Returns true if all events were applied without errors.
+  virtual bool step_batch(const CosimEvent *events, size_t num_events,
+                          size_t &mismatch_idx) = 0;
+
   // When more than one of `set_mip`, `set_nmi` or `set_debug_req` is called
   // before `step` which one takes effect is chosen by the co-simulator. Which
   // should take priority is architecturally defined by the RISC-V
@@ -152,7 +316,11 @@ class Cosim {
   // instruction fault at the given address.
   virtual void set_iside_error(uint32_t addr) = 0;
 
-  // Get a vector of strings describing errors that have occurred during `step`
+  // Get the mismatches that have occurred during `step`
+  virtual const std::vector<CosimMismatch> &get_mismatches() = 0;
+
+  // Get a vector of strings describing errors that have occurred during
+  // `step`. These are formatted from `get_mismatches` when this is called.
   virtual const std::vector<std::string> &get_errors() = 0;
 
   // Clear internal vector of error descriptions
@@ -161,6 +329,28 @@ class Cosim {
   // Returns a count of instructions executed by co-simulator and DUT without
   // failures.
   virtual unsigned int get_insn_cnt() = 0;
+
+  // Capture the state of the co-simulator so it can later be returned to with
+  // `restore_state`. This covers architectural state, memory contents and any
+  // DUT events (e.g. dside accesses) that have been notified but not yet
+  // consumed by a `step`. Errors are not included.
+  //
+  // Memory is captured copy-on-write so taking a snapshot is cheap regardless
+  // of memory size.
+  virtual std::unique_ptr<CosimState> save_state() = 0;
+
+  // Return the co-simulator to a state captured by `save_state`.
+  //
+  // Returns false if the state was captured from an incompatible co-simulator
+  // (e.g. one with different memories), in which case nothing is changed.
+  virtual bool restore_state(const CosimState &state) = 0;
+
+  // Write a captured state to a stream, so it can be stored alongside a
+  // checkpoint of the simulation environment. Returns false on failure.
+  virtual bool write_state(const CosimState &state, std::ostream &out) = 0;
+
+  // Read a state written by `write_state`. Returns nullptr on failure.
+  virtual std::unique_ptr<CosimState> read_state(std::istream &in) = 0;
 };
 
 #endif  // COSIM_H_
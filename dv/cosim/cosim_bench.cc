@@ -0,0 +1,305 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+// Co-simulation throughput benchmark.
+//
+// Replays a co-simulation trace (see cosim_trace.h) into `SpikeCosim` without
+// any RTL simulation and reports instructions per second, heap allocations and
+// a latency histogram for each `Cosim` API called. This allows changes to the
+// co-simulator to be evaluated in isolation.
+//
+// Records before the first event (memory setup and binary loading) are applied
+// once and are not measured. The state after them is saved and restored before
+// each iteration of the measured replay.
+
+#include <getopt.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "cosim_trace.h"
+#include "spike_cosim.h"
+
+// Count every heap allocation made by the process so allocations in the
+// co-simulator hot path can be seen.
+static std::atomic<uint64_t> alloc_count(0);
+
+void *operator new(size_t size) {
+  alloc_count.fetch_add(1, std::memory_order_relaxed);
+
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+// Latency histogram with power of two nanosecond buckets
+class LatencyHistogram {
+ public:
+  static const int kNumBuckets = 32;
+
+  void add(uint64_t ns) {
+    int bucket = 0;
+    while ((bucket < kNumBuckets - 1) && (ns >> (bucket + 1))) {
+      ++bucket;
+    }
+
+    ++buckets[bucket];
+    ++count;
+    total_ns += ns;
+    if (ns > max_ns) {
+      max_ns = ns;
+    }
+  }
+
+  // Approximate percentile, given as the upper bound of the bucket it lies in
+  uint64_t percentile(double p) const {
+    uint64_t target = count * p;
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+      seen += buckets[i];
+      if (seen > target) {
+        return uint64_t(2) << i;
+      }
+    }
+
+    return max_ns;
+  }
+
+  void print(std::ostream &os, const char *name) const {
+    os << std::left << std::setw(20) << name << std::right << std::setw(12)
+       << count << std::setw(10) << (total_ns / count) << std::setw(10)
+       << percentile(0.5) << std::setw(10) << percentile(0.99)
+       << std::setw(12) << max_ns << "\n";
+  }
+
+  void print_buckets(std::ostream &os) const {
+    for (int i = 0; i < kNumBuckets; ++i) {
+      if (buckets[i] != 0) {
+        os << "    < " << std::setw(10) << (uint64_t(2) << i)
+           << " ns: " << buckets[i] << "\n";
+      }
+    }
+  }
+
+  uint64_t count = 0;
+
+ private:
+  uint64_t buckets[kNumBuckets] = {};
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+};
+
+static const char *kApiNames[] = {
+    "step",        "dside_access",     "set_mip",
+    "set_nmi",     "set_nmi_int",      "set_debug_req",
+    "set_mcycle",  "set_csr",          "set_ic_scr_key",
+    "iside_error", "backdoor_write"};
+
+static const int kNumApis = sizeof(kApiNames) / sizeof(kApiNames[0]);
+static const int kApiBackdoorWrite = kNumApis - 1;
+
+static int api_index(const CosimTraceRecord &record) {
+  if (record.type == kCosimTraceEvent) {
+    return record.event.type;
+  }
+
+  return kApiBackdoorWrite;
+}
+
+static void print_usage(const char *prog) {
+  std::cout << "Usage: " << prog << " [options] <trace file>\n\n"
+            << "Options:\n"
+               "  --iterations=N  Replay the trace N times (default 1)\n"
+               "  --fast-fetch    Enable co-simulator fast fetch mode\n"
+               "  --no-latency    Don't time individual calls, only measure\n"
+               "                  overall throughput\n"
+               "  --histogram     Print the full latency histogram for each\n"
+               "                  API\n"
+               "  -h, --help      Show this help\n";
+}
+
+int main(int argc, char **argv) {
+  const struct option long_options[] = {
+      {"iterations", required_argument, nullptr, 'i'},
+      {"fast-fetch", no_argument, nullptr, 'f'},
+      {"no-latency", no_argument, nullptr, 'n'},
+      {"histogram", no_argument, nullptr, 'H'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, no_argument, nullptr, 0}};
+
+  unsigned int iterations = 1;
+  bool fast_fetch = false;
+  bool measure_latency = true;
+  bool print_histogram = false;
+
+  while (1) {
+    int c = getopt_long(argc, argv, "h", long_options, nullptr);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'i':
+        iterations = atoi(optarg);
+        break;
+      case 'f':
+        fast_fetch = true;
+        break;
+      case 'n':
+        measure_latency = false;
+        break;
+      case 'H':
+        print_histogram = true;
+        break;
+      case 'h':
+        print_usage(argv[0]);
+        return 0;
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if ((optind != argc - 1) || (iterations == 0)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  CosimTraceReader reader;
+  if (!reader.open(argv[optind])) {
+    std::cerr << "ERROR: Could not read trace " << argv[optind] << "\n";
+    return 1;
+  }
+
+  // Read the whole trace up front so file I/O isn't measured
+  std::vector<CosimTraceRecord> records;
+  CosimTraceRecord record;
+  while (reader.next(record)) {
+    records.push_back(record);
+  }
+
+  if (reader.error()) {
+    std::cerr << "ERROR: Trace " << argv[optind] << " is corrupt after "
+              << records.size() << " records\n";
+    return 1;
+  }
+
+  const CosimTraceConfig &config = reader.get_config();
+  SpikeCosim cosim(config.isa_string, config.start_pc, config.start_mtvec, "",
+                   config.secure_ibex, config.icache_en,
+                   config.pmp_num_regions, config.pmp_granularity,
+                   config.mhpm_counter_num, config.dm_start_addr,
+                   config.dm_end_addr);
+  cosim.set_fast_fetch(fast_fetch);
+
+  size_t first_event = 0;
+  while ((first_event < records.size()) &&
+         (records[first_event].type != kCosimTraceEvent)) {
+    if (!cosim_trace_apply(cosim, records[first_event])) {
+      std::cerr << "ERROR: Failed to apply setup record " << first_event
+                << "\n";
+      return 1;
+    }
+
+    ++first_event;
+  }
+
+  std::unique_ptr<CosimState> initial_state = cosim.save_state();
+
+  LatencyHistogram latency[kNumApis];
+  uint64_t total_insns = 0;
+  uint64_t total_allocs = 0;
+  std::chrono::steady_clock::duration total_time{};
+
+  for (unsigned int iter = 0; iter < iterations; ++iter) {
+    cosim.restore_state(*initial_state);
+
+    uint64_t allocs_before = alloc_count.load(std::memory_order_relaxed);
+    auto iter_start = std::chrono::steady_clock::now();
+
+    for (size_t i = first_event; i < records.size(); ++i) {
+      bool success;
+
+      if (measure_latency) {
+        auto call_start = std::chrono::steady_clock::now();
+        success = cosim_trace_apply(cosim, records[i]);
+        auto call_end = std::chrono::steady_clock::now();
+
+        latency[api_index(records[i])].add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(call_end -
+                                                                 call_start)
+                .count());
+      } else {
+        success = cosim_trace_apply(cosim, records[i]);
+      }
+
+      if (!success) {
+        std::cerr << "ERROR: Co-simulation mismatch at trace record " << i
+                  << "\n";
+        for (auto &error : cosim.get_errors()) {
+          std::cerr << error << "\n";
+        }
+
+        return 1;
+      }
+    }
+
+    total_time += std::chrono::steady_clock::now() - iter_start;
+    total_allocs += alloc_count.load(std::memory_order_relaxed) - allocs_before;
+    total_insns += cosim.get_insn_cnt();
+  }
+
+  double seconds = std::chrono::duration<double>(total_time).count();
+
+  std::cout << "Replayed " << (records.size() - first_event) << " records "
+            << iterations << " time(s)\n"
+            << "Instructions:        " << total_insns << "\n"
+            << "Time:                " << seconds << " s\n"
+            << "Instructions/second: " << std::fixed << std::setprecision(0)
+            << (total_insns / seconds) << "\n"
+            << "Allocations:         " << total_allocs << " ("
+            << std::setprecision(2)
+            << (total_insns ? double(total_allocs) / total_insns : 0.0)
+            << " per instruction)\n";
+
+  if (!measure_latency) {
+    return 0;
+  }
+
+  std::cout << "\nLatency (ns, percentiles are bucket upper bounds):\n"
+            << std::left << std::setw(20) << "API" << std::right
+            << std::setw(12) << "calls" << std::setw(10) << "mean"
+            << std::setw(10) << "p50" << std::setw(10) << "p99"
+            << std::setw(12) << "max"
+            << "\n";
+
+  for (int i = 0; i < kNumApis; ++i) {
+    if (latency[i].count == 0) {
+      continue;
+    }
+
+    latency[i].print(std::cout, kApiNames[i]);
+    if (print_histogram) {
+      latency[i].print_buckets(std::cout);
+    }
+  }
+
+  return 0;
+}
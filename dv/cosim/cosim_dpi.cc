@@ -7,6 +7,7 @@
 #include <svdpi.h>
 
 #include <cassert>
+#include <vector>
 
 #include "cosim.h"
 
@@ -21,6 +22,86 @@ int riscv_cosim_step(Cosim *cosim, const svBitVecVal *write_reg,
              : 0;
 }
 
+// Decode a single 96-bit event word, see `cosim_dpi.svh` for the layout.
+static CosimEvent decode_cosim_event(const svBitVecVal *event_bits) {
+  uint32_t info = event_bits[0];
+  uint32_t data0 = event_bits[1];
+  uint32_t data1 = event_bits[2];
+
+  CosimEvent event;
+  event.type = static_cast<CosimEventType>(info & 0xff);
+  bool flag = (info >> 16) & 1;
+
+  switch (event.type) {
+    case kCosimEventStep:
+      event.step.write_reg = (info >> 8) & 0x1f;
+      event.step.write_reg_data = data0;
+      event.step.pc = data1;
+      event.step.sync_trap = flag;
+      event.step.suppress_reg_write = (info >> 17) & 1;
+      break;
+    case kCosimEventDSideAccess:
+      event.dside_access.store = flag;
+      event.dside_access.addr = data0;
+      event.dside_access.data = data1;
+      event.dside_access.be = (info >> 24) & 0xf;
+      event.dside_access.error = (info >> 17) & 1;
+      event.dside_access.misaligned_first = (info >> 18) & 1;
+      event.dside_access.misaligned_second = (info >> 19) & 1;
+      event.dside_access.misaligned_first_saw_error = (info >> 20) & 1;
+      event.dside_access.m_mode_access = (info >> 21) & 1;
+      break;
+    case kCosimEventMip:
+      event.mip.pre_mip = data0;
+      event.mip.post_mip = data1;
+      break;
+    case kCosimEventNmi:
+    case kCosimEventNmiInt:
+    case kCosimEventDebugReq:
+    case kCosimEventIcScrKeyValid:
+      event.level = flag;
+      break;
+    case kCosimEventMcycle:
+      event.mcycle = data0 | (uint64_t)data1 << 32;
+      break;
+    case kCosimEventCsr:
+      event.csr.csr_num = data0;
+      event.csr.val = data1;
+      break;
+    case kCosimEventISideError:
+      event.iside_err_addr = data0;
+      break;
+    default:
+      assert(false);
+  }
+
+  return event;
+}
+
+int riscv_cosim_step_batch(Cosim *cosim, const svOpenArrayHandle events,
+                           int start_idx, int num_events) {
+  assert(cosim);
+  assert(start_idx >= 0 && start_idx <= num_events);
+  assert(num_events <= svSize(events, 1));
+
+  std::vector<CosimEvent> decoded_events;
+  decoded_events.reserve(num_events - start_idx);
+
+  int low = svLow(events, 1);
+  for (int i = start_idx; i < num_events; ++i) {
+    decoded_events.push_back(decode_cosim_event(
+        static_cast<const svBitVecVal *>(svGetArrElemPtr1(events, low + i))));
+  }
+
+  size_t mismatch_idx;
+  if (!cosim->step_batch(decoded_events.data(), decoded_events.size(),
+                         mismatch_idx)) {
+    return start_idx + mismatch_idx;
+  }
+
+  return -1;
+}
+
 void riscv_cosim_set_mip(Cosim *cosim, const svBitVecVal *pre_mip,
                          const svBitVecVal *post_mip) {
   assert(cosim);
@@ -95,13 +176,13 @@ void riscv_cosim_set_iside_error(Cosim *cosim, svBitVecVal *addr) {
 int riscv_cosim_get_num_errors(Cosim *cosim) {
   assert(cosim);
 
-  return cosim->get_errors().size();
+  return cosim->get_mismatches().size();
 }
 
 const char *riscv_cosim_get_error(Cosim *cosim, int index) {
   assert(cosim);
 
-  if (index >= cosim->get_errors().size()) {
+  if (index >= cosim->get_mismatches().size()) {
     return nullptr;
   }
 
@@ -0,0 +1,127 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+// Offline co-simulation.
+//
+// Replays a co-simulation trace recorded from an RTL simulation (see
+// recording_cosim.h) into a fresh `SpikeCosim`, checking it exactly as the
+// simulation environment would have done. This allows checking to be re-run
+// (e.g. against a different Spike build or with a Spike trace log) without
+// simulating the RTL again.
+
+#include <getopt.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <string>
+
+#include "cosim_trace.h"
+#include "spike_cosim.h"
+
+static void print_usage(const char *prog) {
+  std::cout << "Usage: " << prog << " [options] <trace file>\n\n"
+            << "Options:\n"
+               "  --log=FILE      Write a Spike instruction trace to FILE\n"
+               "  --fast-fetch    Enable co-simulator fast fetch mode\n"
+               "  --keep-going    Report mismatches and carry on rather than\n"
+               "                  stopping at the first one\n"
+               "  -h, --help      Show this help\n";
+}
+
+int main(int argc, char **argv) {
+  const struct option long_options[] = {
+      {"log", required_argument, nullptr, 'l'},
+      {"fast-fetch", no_argument, nullptr, 'f'},
+      {"keep-going", no_argument, nullptr, 'k'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, no_argument, nullptr, 0}};
+
+  std::string log_path;
+  bool fast_fetch = false;
+  bool keep_going = false;
+
+  while (1) {
+    int c = getopt_long(argc, argv, "h", long_options, nullptr);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+      case 'l':
+        log_path = optarg;
+        break;
+      case 'f':
+        fast_fetch = true;
+        break;
+      case 'k':
+        keep_going = true;
+        break;
+      case 'h':
+        print_usage(argv[0]);
+        return 0;
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind != argc - 1) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  CosimTraceReader reader;
+  if (!reader.open(argv[optind])) {
+    std::cerr << "ERROR: Could not read trace " << argv[optind] << "\n";
+    return 1;
+  }
+
+  const CosimTraceConfig &config = reader.get_config();
+  SpikeCosim cosim(config.isa_string, config.start_pc, config.start_mtvec,
+                   log_path, config.secure_ibex, config.icache_en,
+                   config.pmp_num_regions, config.pmp_granularity,
+                   config.mhpm_counter_num, config.dm_start_addr,
+                   config.dm_end_addr);
+  cosim.set_fast_fetch(fast_fetch);
+
+  CosimTraceRecord record;
+  uint64_t record_idx = 0;
+  unsigned int num_mismatches = 0;
+
+  for (; reader.next(record); ++record_idx) {
+    if (cosim_trace_apply(cosim, record)) {
+      continue;
+    }
+
+    ++num_mismatches;
+
+    std::cout << "FAILURE: Co-simulation mismatch at trace record "
+              << record_idx << " after " << cosim.get_insn_cnt()
+              << " matched instructions\n";
+    for (auto &error : cosim.get_errors()) {
+      std::cout << error << "\n";
+    }
+
+    if (!keep_going) {
+      return 1;
+    }
+
+    cosim.clear_errors();
+  }
+
+  if (reader.error()) {
+    std::cerr << "ERROR: Trace " << argv[optind] << " is corrupt at record "
+              << record_idx << "\n";
+    return 1;
+  }
+
+  std::cout << "Co-simulation replayed " << record_idx << " records, matched "
+            << cosim.get_insn_cnt() << " instructions";
+  if (num_mismatches != 0) {
+    std::cout << " with " << num_mismatches << " mismatches";
+  }
+  std::cout << "\n";
+
+  return num_mismatches == 0 ? 0 : 1;
+}
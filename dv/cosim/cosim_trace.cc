@@ -0,0 +1,176 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "cosim_trace.h"
+
+#include <cassert>
+#include <cstring>
+
+static const char kTraceMagic[8] = {'I', 'B', 'X', 'C', 'T', 'R', 'C', '1'};
+
+template <typename T>
+static void write_pod(std::ostream &out, const T &val) {
+  out.write(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template <typename T>
+static bool read_pod(std::istream &in, T &val) {
+  in.read(reinterpret_cast<char *>(&val), sizeof(T));
+  return in.good();
+}
+
+bool CosimTraceWriter::open(const std::string &path,
+                            const CosimTraceConfig &config) {
+  out.open(path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+
+  out.write(kTraceMagic, sizeof(kTraceMagic));
+
+  write_pod(out, static_cast<uint32_t>(config.isa_string.size()));
+  out.write(config.isa_string.data(), config.isa_string.size());
+  write_pod(out, config.start_pc);
+  write_pod(out, config.start_mtvec);
+  write_pod(out, static_cast<uint8_t>(config.secure_ibex));
+  write_pod(out, static_cast<uint8_t>(config.icache_en));
+  write_pod(out, config.pmp_num_regions);
+  write_pod(out, config.pmp_granularity);
+  write_pod(out, config.mhpm_counter_num);
+  write_pod(out, config.dm_start_addr);
+  write_pod(out, config.dm_end_addr);
+
+  return out.good();
+}
+
+bool CosimTraceWriter::close() {
+  if (!out.is_open()) {
+    return false;
+  }
+
+  out.flush();
+  bool success = out.good();
+  out.close();
+
+  return success;
+}
+
+void CosimTraceWriter::add_memory(uint32_t base_addr, size_t size) {
+  write_pod(out, static_cast<uint8_t>(kCosimTraceAddMemory));
+  write_pod(out, base_addr);
+  write_pod(out, static_cast<uint64_t>(size));
+}
+
+void CosimTraceWriter::backdoor_write(uint32_t addr, size_t len,
+                                      const uint8_t *data) {
+  write_pod(out, static_cast<uint8_t>(kCosimTraceBackdoorWrite));
+  write_pod(out, addr);
+  write_pod(out, static_cast<uint64_t>(len));
+  out.write(reinterpret_cast<const char *>(data), len);
+}
+
+void CosimTraceWriter::event(const CosimEvent &event) {
+  write_pod(out, static_cast<uint8_t>(kCosimTraceEvent));
+  write_pod(out, event);
+}
+
+bool CosimTraceReader::open(const std::string &path) {
+  in.open(path, std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+
+  char magic[sizeof(kTraceMagic)];
+  in.read(magic, sizeof(magic));
+  if (!in.good() || memcmp(magic, kTraceMagic, sizeof(magic)) != 0) {
+    return false;
+  }
+
+  // Guard against a corrupt length allocating a huge string
+  const uint32_t kMaxIsaLen = 256;
+
+  uint32_t isa_len;
+  if (!read_pod(in, isa_len) || isa_len > kMaxIsaLen) {
+    return false;
+  }
+
+  config.isa_string.resize(isa_len);
+  in.read(&config.isa_string[0], isa_len);
+
+  uint8_t secure_ibex;
+  uint8_t icache_en;
+  read_pod(in, config.start_pc);
+  read_pod(in, config.start_mtvec);
+  read_pod(in, secure_ibex);
+  read_pod(in, icache_en);
+  read_pod(in, config.pmp_num_regions);
+  read_pod(in, config.pmp_granularity);
+  read_pod(in, config.mhpm_counter_num);
+  read_pod(in, config.dm_start_addr);
+  read_pod(in, config.dm_end_addr);
+
+  config.secure_ibex = secure_ibex;
+  config.icache_en = icache_en;
+
+  return in.good();
+}
+
+bool CosimTraceReader::next(CosimTraceRecord &record) {
+  uint8_t type;
+  in.read(reinterpret_cast<char *>(&type), 1);
+  if (in.eof() && in.gcount() == 0) {
+    // Clean end of trace
+    return false;
+  }
+
+  if (!in.good()) {
+    read_error = true;
+    return false;
+  }
+
+  record.type = static_cast<CosimTraceRecordType>(type);
+
+  bool success;
+  switch (record.type) {
+    case kCosimTraceAddMemory:
+      success = read_pod(in, record.addr) && read_pod(in, record.size);
+      break;
+    case kCosimTraceBackdoorWrite:
+      success = read_pod(in, record.addr) && read_pod(in, record.size);
+      if (success) {
+        record.data.resize(record.size);
+        in.read(reinterpret_cast<char *>(record.data.data()), record.size);
+        success = in.good();
+      }
+      break;
+    case kCosimTraceEvent:
+      success = read_pod(in, record.event);
+      break;
+    default:
+      success = false;
+  }
+
+  read_error = !success;
+
+  return success;
+}
+
+bool cosim_trace_apply(Cosim &cosim, const CosimTraceRecord &record) {
+  size_t mismatch_idx;
+
+  switch (record.type) {
+    case kCosimTraceAddMemory:
+      cosim.add_memory(record.addr, record.size);
+      return true;
+    case kCosimTraceBackdoorWrite:
+      return cosim.backdoor_write_mem(record.addr, record.data.size(),
+                                      record.data.data());
+    case kCosimTraceEvent:
+      return cosim.step_batch(&record.event, 1, mismatch_idx);
+    default:
+      assert(false);
+  }
+
+  return false;
+}
@@ -0,0 +1,96 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef COSIM_TRACE_H_
+#define COSIM_TRACE_H_
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cosim.h"
+
+// Co-simulation traces record everything the simulation environment tells the
+// co-simulator (retired instructions, dside accesses, interrupts, backdoor
+// memory writes etc) so a run can later be replayed into a co-simulator
+// without the RTL simulation.
+//
+// A trace file begins with the magic string "IBXCTRC1" followed by a
+// `CosimTraceConfig` then a sequence of records. Each record is a one byte
+// `CosimTraceRecordType` followed by its contents. Values are in host byte
+// order.
+
+// Configuration of the co-simulator that produced the trace. This matches the
+// `SpikeCosim` constructor arguments.
+struct CosimTraceConfig {
+  std::string isa_string;
+  uint32_t start_pc;
+  uint32_t start_mtvec;
+  bool secure_ibex;
+  bool icache_en;
+  uint32_t pmp_num_regions;
+  uint32_t pmp_granularity;
+  uint32_t mhpm_counter_num;
+  uint32_t dm_start_addr;
+  uint32_t dm_end_addr;
+};
+
+enum CosimTraceRecordType {
+  // `Cosim::add_memory`, `addr` and `size` give the memory base and size
+  kCosimTraceAddMemory,
+  // `Cosim::backdoor_write_mem`, `data` holds the bytes written to `addr`
+  kCosimTraceBackdoorWrite,
+  // Any call that can be expressed as a `CosimEvent`, held in `event`
+  kCosimTraceEvent
+};
+
+struct CosimTraceRecord {
+  CosimTraceRecordType type;
+  uint32_t addr;
+  uint64_t size;
+  std::vector<uint8_t> data;
+  CosimEvent event;
+};
+
+class CosimTraceWriter {
+ public:
+  // Create a trace file at `path`, returns false if it could not be created.
+  bool open(const std::string &path, const CosimTraceConfig &config);
+  bool is_open() const { return out.is_open(); }
+  // Flush and close the trace, returns false if any write failed.
+  bool close();
+
+  void add_memory(uint32_t base_addr, size_t size);
+  void backdoor_write(uint32_t addr, size_t len, const uint8_t *data);
+  void event(const CosimEvent &event);
+
+ private:
+  std::ofstream out;
+};
+
+class CosimTraceReader {
+ public:
+  // Open the trace file at `path` and read its configuration. Returns false
+  // if it cannot be opened or isn't a trace file.
+  bool open(const std::string &path);
+  const CosimTraceConfig &get_config() const { return config; }
+
+  // Read the next record into `record`. Returns false at the end of the trace
+  // or if the record couldn't be read, use `error` to distinguish the two.
+  bool next(CosimTraceRecord &record);
+  bool error() const { return read_error; }
+
+ private:
+  std::ifstream in;
+  CosimTraceConfig config;
+  bool read_error = false;
+};
+
+// Apply a trace record to a co-simulator. Returns false if a step or backdoor
+// write fails.
+bool cosim_trace_apply(Cosim &cosim, const CosimTraceRecord &record);
+
+#endif  // COSIM_TRACE_H_
@@ -0,0 +1,104 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "multi_hart_cosim.h"
+
+#include <cassert>
+
+#include "sparse_mem.h"
+
+MultiHartCosim::MultiHartCosim(
+    unsigned int num_harts, const std::string &isa_string, uint32_t start_pc,
+    uint32_t start_mtvec, const std::string &trace_log_path, bool secure_ibex,
+    bool icache_en, uint32_t pmp_num_regions, uint32_t pmp_granularity,
+    uint32_t mhpm_counter_num, uint32_t dm_start_addr, uint32_t dm_end_addr) {
+  assert(num_harts > 0);
+
+  std::vector<SpikeCosim *> hart_ptrs;
+
+  for (unsigned int i = 0; i < num_harts; ++i) {
+    std::string log_path = trace_log_path;
+    if (num_harts > 1 && log_path.length() != 0) {
+      log_path += ".hart" + std::to_string(i);
+    }
+
+    harts.emplace_back(std::make_unique<SpikeCosim>(
+        isa_string, start_pc, start_mtvec, log_path, secure_ibex, icache_en,
+        pmp_num_regions, pmp_granularity, mhpm_counter_num, dm_start_addr,
+        dm_end_addr, i));
+    hart_ptrs.push_back(harts.back().get());
+  }
+
+  for (auto &hart : harts) {
+    hart->set_shared_mem_harts(hart_ptrs);
+  }
+}
+
+SpikeCosim *MultiHartCosim::get_hart(unsigned int hart_id) {
+  if (hart_id >= harts.size()) {
+    return nullptr;
+  }
+
+  return harts[hart_id].get();
+}
+
+void MultiHartCosim::add_memory(uint32_t base_addr, size_t size) {
+  auto mem = std::make_shared<SparseMem>(size);
+
+  for (auto &hart : harts) {
+    hart->add_shared_memory(base_addr, mem);
+  }
+}
+
+bool MultiHartCosim::backdoor_write_mem(uint32_t addr, size_t len,
+                                        const uint8_t *data_in) {
+  // Memory is shared so writing via any hart is seen by all of them
+  return harts[0]->backdoor_write_mem(addr, len, data_in);
+}
+
+bool MultiHartCosim::backdoor_read_mem(uint32_t addr, size_t len,
+                                       uint8_t *data_out) {
+  return harts[0]->backdoor_read_mem(addr, len, data_out);
+}
+
+bool MultiHartCosim::step_batch(const unsigned int *hart_ids,
+                                const CosimEvent *events, size_t num_events,
+                                size_t &mismatch_idx) {
+  size_t run_start = 0;
+
+  while (run_start < num_events) {
+    unsigned int hart_id = hart_ids[run_start];
+
+    if (hart_id >= harts.size()) {
+      mismatch_idx = run_start;
+      return false;
+    }
+
+    size_t run_end = run_start + 1;
+    while (run_end < num_events && hart_ids[run_end] == hart_id) {
+      ++run_end;
+    }
+
+    size_t run_mismatch_idx;
+    if (!harts[hart_id]->step_batch(events + run_start, run_end - run_start,
+                                    run_mismatch_idx)) {
+      mismatch_idx = run_start + run_mismatch_idx;
+      return false;
+    }
+
+    run_start = run_end;
+  }
+
+  return true;
+}
+
+unsigned int MultiHartCosim::get_insn_cnt() {
+  unsigned int insn_cnt = 0;
+
+  for (auto &hart : harts) {
+    insn_cnt += hart->get_insn_cnt();
+  }
+
+  return insn_cnt;
+}
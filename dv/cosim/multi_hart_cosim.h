@@ -0,0 +1,67 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef MULTI_HART_COSIM_H_
+#define MULTI_HART_COSIM_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cosim.h"
+#include "spike_cosim.h"
+
+// Co-simulation of several Ibex harts that share memory. Each hart gets its
+// own `SpikeCosim` (with its own processor, using the hart number as its
+// hart id) and all of them share the same memory devices, so a store from one
+// hart is seen by the others.
+//
+// Each hart's `SpikeCosim` is driven through the `Cosim` interface as for a
+// single hart, use `get_hart` to obtain it. Alternatively events from all harts
+// can be routed through `step_batch`. Memory must be added via `add_memory`
+// here, memory added directly to one hart is not shared.
+//
+// Memory ordering between harts follows the order DUT data side accesses are
+// notified in (see `SpikeCosim::set_shared_mem_harts`), so accesses must be
+// notified to each hart as they happen in the DUT, interleaved across harts in
+// the same order.
+class MultiHartCosim {
+ public:
+  // All harts are created with the same configuration. With more than one
+  // hart `trace_log_path` has the hart number appended for each hart's log.
+  MultiHartCosim(unsigned int num_harts, const std::string &isa_string,
+                 uint32_t start_pc, uint32_t start_mtvec,
+                 const std::string &trace_log_path, bool secure_ibex,
+                 bool icache_en, uint32_t pmp_num_regions,
+                 uint32_t pmp_granularity, uint32_t mhpm_counter_num,
+                 uint32_t dm_start_addr, uint32_t dm_end_addr);
+
+  unsigned int get_num_harts() const { return harts.size(); }
+
+  // Returns nullptr if `hart_id` doesn't exist
+  SpikeCosim *get_hart(unsigned int hart_id);
+
+  // Add a memory shared by all harts
+  void add_memory(uint32_t base_addr, size_t size);
+
+  // Backdoor accesses to the shared memory, see `Cosim`
+  bool backdoor_write_mem(uint32_t addr, size_t len, const uint8_t *data_in);
+  bool backdoor_read_mem(uint32_t addr, size_t len, uint8_t *data_out);
+
+  // Apply `num_events` events where `events[i]` is for hart `hart_ids[i]`.
+  // Events are applied in order, runs of events for the same hart are passed
+  // to that hart's `step_batch` together. Returns false on the first event
+  // that fails, with its index in `mismatch_idx`, errors are available from
+  // the hart it was for. An event for a hart that doesn't exist also fails.
+  bool step_batch(const unsigned int *hart_ids, const CosimEvent *events,
+                  size_t num_events, size_t &mismatch_idx);
+
+  // Total instructions stepped by all harts
+  unsigned int get_insn_cnt();
+
+ private:
+  std::vector<std::unique_ptr<SpikeCosim>> harts;
+};
+
+#endif  // MULTI_HART_COSIM_H_
@@ -0,0 +1,189 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "recording_cosim.h"
+
+#include <cassert>
+
+RecordingCosim::RecordingCosim(std::unique_ptr<Cosim> cosim,
+                               const std::string &trace_path,
+                               const CosimTraceConfig &config)
+    : cosim(std::move(cosim)) {
+  assert(this->cosim);
+
+  if (!trace.open(trace_path, config)) {
+    trace.close();
+  }
+}
+
+RecordingCosim::~RecordingCosim() { trace.close(); }
+
+void RecordingCosim::record_event(const CosimEvent &event) {
+  if (trace.is_open()) {
+    trace.event(event);
+  }
+}
+
+void RecordingCosim::add_memory(uint32_t base_addr, size_t size) {
+  if (trace.is_open()) {
+    trace.add_memory(base_addr, size);
+  }
+
+  cosim->add_memory(base_addr, size);
+}
+
+bool RecordingCosim::backdoor_write_mem(uint32_t addr, size_t len,
+                                        const uint8_t *data_in) {
+  if (trace.is_open()) {
+    trace.backdoor_write(addr, len, data_in);
+  }
+
+  return cosim->backdoor_write_mem(addr, len, data_in);
+}
+
+bool RecordingCosim::backdoor_read_mem(uint32_t addr, size_t len,
+                                       uint8_t *data_out) {
+  return cosim->backdoor_read_mem(addr, len, data_out);
+}
+
+bool RecordingCosim::step(uint32_t write_reg, uint32_t write_reg_data,
+                          uint32_t pc, bool sync_trap,
+                          bool suppress_reg_write) {
+  CosimEvent event;
+  event.type = kCosimEventStep;
+  event.step.write_reg = write_reg;
+  event.step.write_reg_data = write_reg_data;
+  event.step.pc = pc;
+  event.step.sync_trap = sync_trap;
+  event.step.suppress_reg_write = suppress_reg_write;
+  record_event(event);
+
+  return cosim->step(write_reg, write_reg_data, pc, sync_trap,
+                     suppress_reg_write);
+}
+
+bool RecordingCosim::step_batch(const CosimEvent *events, size_t num_events,
+                                size_t &mismatch_idx) {
+  bool success = cosim->step_batch(events, num_events, mismatch_idx);
+
+  // Only record the events that were applied, the environment may hand the
+  // remainder over again after a mismatch.
+  size_t num_applied = success ? num_events : mismatch_idx + 1;
+  for (size_t i = 0; i < num_applied; ++i) {
+    record_event(events[i]);
+  }
+
+  return success;
+}
+
+void RecordingCosim::set_mip(uint32_t pre_mip, uint32_t post_mip) {
+  CosimEvent event;
+  event.type = kCosimEventMip;
+  event.mip.pre_mip = pre_mip;
+  event.mip.post_mip = post_mip;
+  record_event(event);
+
+  cosim->set_mip(pre_mip, post_mip);
+}
+
+void RecordingCosim::set_nmi(bool nmi) {
+  CosimEvent event;
+  event.type = kCosimEventNmi;
+  event.level = nmi;
+  record_event(event);
+
+  cosim->set_nmi(nmi);
+}
+
+void RecordingCosim::set_nmi_int(bool nmi_int) {
+  CosimEvent event;
+  event.type = kCosimEventNmiInt;
+  event.level = nmi_int;
+  record_event(event);
+
+  cosim->set_nmi_int(nmi_int);
+}
+
+void RecordingCosim::set_debug_req(bool debug_req) {
+  CosimEvent event;
+  event.type = kCosimEventDebugReq;
+  event.level = debug_req;
+  record_event(event);
+
+  cosim->set_debug_req(debug_req);
+}
+
+void RecordingCosim::set_mcycle(uint64_t mcycle) {
+  CosimEvent event;
+  event.type = kCosimEventMcycle;
+  event.mcycle = mcycle;
+  record_event(event);
+
+  cosim->set_mcycle(mcycle);
+}
+
+void RecordingCosim::set_csr(const int csr_num, const uint32_t new_val) {
+  CosimEvent event;
+  event.type = kCosimEventCsr;
+  event.csr.csr_num = csr_num;
+  event.csr.val = new_val;
+  record_event(event);
+
+  cosim->set_csr(csr_num, new_val);
+}
+
+void RecordingCosim::set_ic_scr_key_valid(bool valid) {
+  CosimEvent event;
+  event.type = kCosimEventIcScrKeyValid;
+  event.level = valid;
+  record_event(event);
+
+  cosim->set_ic_scr_key_valid(valid);
+}
+
+void RecordingCosim::notify_dside_access(const DSideAccessInfo &access_info) {
+  CosimEvent event;
+  event.type = kCosimEventDSideAccess;
+  event.dside_access = access_info;
+  record_event(event);
+
+  cosim->notify_dside_access(access_info);
+}
+
+void RecordingCosim::set_iside_error(uint32_t addr) {
+  CosimEvent event;
+  event.type = kCosimEventISideError;
+  event.iside_err_addr = addr;
+  record_event(event);
+
+  cosim->set_iside_error(addr);
+}
+
+const std::vector<CosimMismatch> &RecordingCosim::get_mismatches() {
+  return cosim->get_mismatches();
+}
+
+const std::vector<std::string> &RecordingCosim::get_errors() {
+  return cosim->get_errors();
+}
+
+void RecordingCosim::clear_errors() { cosim->clear_errors(); }
+
+unsigned int RecordingCosim::get_insn_cnt() { return cosim->get_insn_cnt(); }
+
+std::unique_ptr<CosimState> RecordingCosim::save_state() {
+  return cosim->save_state();
+}
+
+bool RecordingCosim::restore_state(const CosimState &state) {
+  return cosim->restore_state(state);
+}
+
+bool RecordingCosim::write_state(const CosimState &state, std::ostream &out) {
+  return cosim->write_state(state, out);
+}
+
+std::unique_ptr<CosimState> RecordingCosim::read_state(std::istream &in) {
+  return cosim->read_state(in);
+}
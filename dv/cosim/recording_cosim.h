@@ -0,0 +1,69 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef RECORDING_COSIM_H_
+#define RECORDING_COSIM_H_
+
+#include <memory>
+#include <string>
+
+#include "cosim.h"
+#include "cosim_trace.h"
+
+// A `Cosim` that records every call that affects co-simulation into a trace
+// file (see cosim_trace.h) before passing it on to another `Cosim`. The trace
+// can be replayed later with `cosim_replay` to re-run checking without the RTL
+// simulation.
+//
+// Errors aren't recorded so a replay that should carry on past a mismatch
+// needs to clear them itself. Saving and restoring state isn't recorded, a
+// trace is only valid for a run that doesn't call `restore_state`.
+class RecordingCosim : public Cosim {
+ public:
+  // Takes ownership of `cosim`. `config` must describe how `cosim` was
+  // created. If the trace can't be created the calls are still passed on but
+  // nothing is recorded, check with `is_recording`.
+  RecordingCosim(std::unique_ptr<Cosim> cosim, const std::string &trace_path,
+                 const CosimTraceConfig &config);
+  ~RecordingCosim();
+
+  bool is_recording() const { return trace.is_open(); }
+
+  Cosim *get_wrapped() { return cosim.get(); }
+
+  // Cosim implementation
+  void add_memory(uint32_t base_addr, size_t size) override;
+  bool backdoor_write_mem(uint32_t addr, size_t len,
+                          const uint8_t *data_in) override;
+  bool backdoor_read_mem(uint32_t addr, size_t len, uint8_t *data_out) override;
+  bool step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
+            bool sync_trap, bool suppress_reg_write) override;
+  bool step_batch(const CosimEvent *events, size_t num_events,
+                  size_t &mismatch_idx) override;
+  void set_mip(uint32_t pre_mip, uint32_t post_mip) override;
+  void set_nmi(bool nmi) override;
+  void set_nmi_int(bool nmi_int) override;
+  void set_debug_req(bool debug_req) override;
+  void set_mcycle(uint64_t mcycle) override;
+  void set_csr(const int csr_num, const uint32_t new_val) override;
+  void set_ic_scr_key_valid(bool valid) override;
+  void notify_dside_access(const DSideAccessInfo &access_info) override;
+  void set_iside_error(uint32_t addr) override;
+  const std::vector<CosimMismatch> &get_mismatches() override;
+  const std::vector<std::string> &get_errors() override;
+  void clear_errors() override;
+  unsigned int get_insn_cnt() override;
+  std::unique_ptr<CosimState> save_state() override;
+  bool restore_state(const CosimState &state) override;
+  bool write_state(const CosimState &state, std::ostream &out) override;
+  std::unique_ptr<CosimState> read_state(std::istream &in) override;
+
+ private:
+  std::unique_ptr<Cosim> cosim;
+  CosimTraceWriter trace;
+
+  void record_event(const CosimEvent &event);
+};
+
+#endif  // RECORDING_COSIM_H_
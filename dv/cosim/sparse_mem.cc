@@ -0,0 +1,198 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "sparse_mem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+SparseMem::SparseMem(size_t size)
+    : size_(size), num_touched_pages_(0), num_page_copies_(0) {
+  assert(size != 0);
+
+  size_t leaf_span = kLeafEntries * kPageSize;
+  page_table_.resize((size + leaf_span - 1) / leaf_span);
+}
+
+bool SparseMem::load(reg_t addr, size_t len, uint8_t *bytes) {
+  if (addr >= size_ || len > size_ - addr) {
+    return false;
+  }
+
+  while (len != 0) {
+    size_t page_offset = addr & (kPageSize - 1);
+    size_t chunk_len = std::min(len, kPageSize - page_offset);
+
+    const uint8_t *page = find_page(addr);
+    if (page) {
+      memcpy(bytes, page + page_offset, chunk_len);
+    } else {
+      memset(bytes, 0, chunk_len);
+    }
+
+    addr += chunk_len;
+    bytes += chunk_len;
+    len -= chunk_len;
+  }
+
+  return true;
+}
+
+bool SparseMem::store(reg_t addr, size_t len, const uint8_t *bytes) {
+  if (addr >= size_ || len > size_ - addr) {
+    return false;
+  }
+
+  while (len != 0) {
+    size_t page_offset = addr & (kPageSize - 1);
+    size_t chunk_len = std::min(len, kPageSize - page_offset);
+
+    memcpy(get_page(addr) + page_offset, bytes, chunk_len);
+
+    addr += chunk_len;
+    bytes += chunk_len;
+    len -= chunk_len;
+  }
+
+  return true;
+}
+
+char *SparseMem::contents(reg_t addr) {
+  assert(addr < size_);
+
+  const std::shared_ptr<Leaf> &leaf =
+      page_table_[addr >> (kPageBits + kLeafBits)];
+  if (!leaf || leaf.use_count() > 1) {
+    return nullptr;
+  }
+
+  const std::shared_ptr<Page> &page =
+      (*leaf)[(addr >> kPageBits) & (kLeafEntries - 1)];
+  if (!page || page.use_count() > 1) {
+    return nullptr;
+  }
+
+  return reinterpret_cast<char *>(page->data() + (addr & (kPageSize - 1)));
+}
+
+SparseMem::Snapshot SparseMem::save() const {
+  Snapshot snapshot;
+  snapshot.page_table_ = page_table_;
+  snapshot.num_touched_pages_ = num_touched_pages_;
+
+  return snapshot;
+}
+
+void SparseMem::restore(const Snapshot &snapshot) {
+  assert(snapshot.page_table_.size() == page_table_.size());
+
+  page_table_ = snapshot.page_table_;
+  num_touched_pages_ = snapshot.num_touched_pages_;
+}
+
+// Snapshots are written as the memory size and touched page count followed by
+// the index and contents of each touched page. Values are in host byte order.
+bool SparseMem::write_snapshot(const Snapshot &snapshot,
+                               std::ostream &out) const {
+  uint64_t size = size_;
+  uint64_t num_pages = snapshot.num_touched_pages_;
+  out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  out.write(reinterpret_cast<const char *>(&num_pages), sizeof(num_pages));
+
+  for (size_t leaf_idx = 0; leaf_idx < snapshot.page_table_.size();
+       ++leaf_idx) {
+    const std::shared_ptr<Leaf> &leaf = snapshot.page_table_[leaf_idx];
+    if (!leaf) {
+      continue;
+    }
+
+    for (size_t page_idx = 0; page_idx < kLeafEntries; ++page_idx) {
+      const std::shared_ptr<Page> &page = (*leaf)[page_idx];
+      if (!page) {
+        continue;
+      }
+
+      uint64_t page_num = (leaf_idx << kLeafBits) | page_idx;
+      out.write(reinterpret_cast<const char *>(&page_num), sizeof(page_num));
+      out.write(reinterpret_cast<const char *>(page->data()), kPageSize);
+    }
+  }
+
+  return out.good();
+}
+
+bool SparseMem::read_snapshot(std::istream &in, Snapshot &snapshot) const {
+  uint64_t size;
+  uint64_t num_pages;
+  in.read(reinterpret_cast<char *>(&size), sizeof(size));
+  in.read(reinterpret_cast<char *>(&num_pages), sizeof(num_pages));
+
+  if (!in.good() || size != size_) {
+    return false;
+  }
+
+  snapshot.page_table_.clear();
+  snapshot.page_table_.resize(page_table_.size());
+  snapshot.num_touched_pages_ = num_pages;
+
+  for (uint64_t i = 0; i < num_pages; ++i) {
+    uint64_t page_num;
+    in.read(reinterpret_cast<char *>(&page_num), sizeof(page_num));
+
+    if (!in.good() || (page_num << kPageBits) >= size_) {
+      return false;
+    }
+
+    std::shared_ptr<Leaf> &leaf = snapshot.page_table_[page_num >> kLeafBits];
+    if (!leaf) {
+      leaf = std::make_shared<Leaf>();
+    }
+
+    auto page = std::make_shared<Page>();
+    in.read(reinterpret_cast<char *>(page->data()), kPageSize);
+    (*leaf)[page_num & (kLeafEntries - 1)] = std::move(page);
+  }
+
+  return in.good();
+}
+
+const uint8_t *SparseMem::find_page(reg_t addr) const {
+  const std::shared_ptr<Leaf> &leaf =
+      page_table_[addr >> (kPageBits + kLeafBits)];
+  if (!leaf) {
+    return nullptr;
+  }
+
+  const std::shared_ptr<Page> &page =
+      (*leaf)[(addr >> kPageBits) & (kLeafEntries - 1)];
+
+  return page ? page->data() : nullptr;
+}
+
+uint8_t *SparseMem::get_page(reg_t addr) {
+  std::shared_ptr<Leaf> &leaf = page_table_[addr >> (kPageBits + kLeafBits)];
+  if (!leaf) {
+    leaf = std::make_shared<Leaf>();
+  } else if (leaf.use_count() > 1) {
+    // Leaf is shared with a snapshot, take a private copy. The pages it points
+    // to remain shared.
+    leaf = std::make_shared<Leaf>(*leaf);
+  }
+
+  std::shared_ptr<Page> &page =
+      (*leaf)[(addr >> kPageBits) & (kLeafEntries - 1)];
+  if (!page) {
+    // Value-initialise so new pages read as zero
+    page = std::make_shared<Page>();
+    ++num_touched_pages_;
+  } else if (page.use_count() > 1) {
+    page = std::make_shared<Page>(*page);
+    ++num_page_copies_;
+  }
+
+  return page->data();
+}
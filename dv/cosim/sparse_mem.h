@@ -0,0 +1,101 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef SPARSE_MEM_H_
+#define SPARSE_MEM_H_
+
+#include <stdint.h>
+
+#include <array>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+#include "riscv/devices.h"
+
+// A memory device for spike that only allocates storage for the parts of its
+// address range that are written.
+//
+// Storage is allocated in pages of `kPageSize` bytes on the first write to a
+// page, found via a two-level page table. Reads from pages that have never
+// been written return zero without allocating anything. This allows a memory
+// covering the entire 32-bit address space to be added to the co-simulator
+// with a host memory cost that only depends upon how much of it the program
+// actually uses.
+//
+// Pages and page table leaves are shared copy-on-write between the memory and
+// any snapshots taken with `save`, so a snapshot costs nothing until the
+// memory is next written.
+class SparseMem : public abstract_device_t {
+ public:
+  static constexpr unsigned kPageBits = 12;
+  static constexpr size_t kPageSize = 1 << kPageBits;
+
+ private:
+  static constexpr unsigned kLeafBits = 10;
+  static constexpr size_t kLeafEntries = 1 << kLeafBits;
+
+  typedef std::array<uint8_t, kPageSize> Page;
+  typedef std::array<std::shared_ptr<Page>, kLeafEntries> Leaf;
+  typedef std::vector<std::shared_ptr<Leaf>> PageTable;
+
+ public:
+  // Memory contents captured by `save`
+  class Snapshot {
+   private:
+    friend class SparseMem;
+
+    PageTable page_table_;
+    size_t num_touched_pages_ = 0;
+  };
+
+  explicit SparseMem(size_t size);
+
+  // abstract_device_t implementation. `addr` is an offset from the start of
+  // the device, accesses may cross page boundaries but not the end of the
+  // device.
+  bool load(reg_t addr, size_t len, uint8_t *bytes) override;
+  bool store(reg_t addr, size_t len, const uint8_t *bytes) override;
+
+  // Return a host pointer to the byte at `addr`, or nullptr if its page has
+  // never been written or is shared with a snapshot. This never allocates or
+  // copies a page, so looking up a pointer doesn't move a page another user
+  // of the memory has a pointer to. The pointer is only valid for accesses
+  // within the same page and until the next time `num_page_copies` changes
+  // (a write to a page shared with a snapshot moves it) or `restore` is
+  // called.
+  char *contents(reg_t addr);
+
+  size_t size() const { return size_; }
+
+  // Number of pages that have had storage allocated
+  size_t num_touched_pages() const { return num_touched_pages_; }
+
+  // Number of times a write has copied a page shared with a snapshot
+  size_t num_page_copies() const { return num_page_copies_; }
+
+  // Capture or restore the memory contents
+  Snapshot save() const;
+  void restore(const Snapshot &snapshot);
+
+  // Write a snapshot to a stream, or read one written by `write_snapshot` for
+  // a memory of the same size. Return false on a stream error or if the
+  // snapshot doesn't fit this memory.
+  bool write_snapshot(const Snapshot &snapshot, std::ostream &out) const;
+  bool read_snapshot(std::istream &in, Snapshot &snapshot) const;
+
+ private:
+  // Return the page holding `addr`, nullptr if it has never been written.
+  const uint8_t *find_page(reg_t addr) const;
+  // Return the page holding `addr` for writing, allocating it or copying it
+  // from a snapshot if required.
+  uint8_t *get_page(reg_t addr);
+
+  size_t size_;
+  size_t num_touched_pages_;
+  size_t num_page_copies_;
+  PageTable page_table_;
+};
+
+#endif  // SPARSE_MEM_H_
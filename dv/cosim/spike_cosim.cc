@@ -4,9 +4,9 @@
 
 #include "spike_cosim.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
-#include <sstream>
 
 #include "riscv/config.h"
 #include "riscv/decode.h"
@@ -38,39 +38,62 @@ SpikeCosim::SpikeCosim(const std::string &isa_string, uint32_t start_pc,
                        bool secure_ibex, bool icache_en,
                        uint32_t pmp_num_regions, uint32_t pmp_granularity,
                        uint32_t mhpm_counter_num, uint32_t dm_start_addr,
-                       uint32_t dm_end_addr)
-    : nmi_mode(false), pending_iside_error(false), insn_cnt(0) {
-  FILE *log_file = nullptr;
+                       uint32_t dm_end_addr, uint32_t hart_id)
+    : proc_config{isa_string,      start_pc,        start_mtvec,
+                  secure_ibex,     icache_en,       pmp_num_regions,
+                  pmp_granularity, mhpm_counter_num, dm_start_addr,
+                  dm_end_addr,     hart_id},
+      nmi_mode(false),
+      pending_iside_error(false),
+      fast_fetch(false),
+      free_running(false),
+      shared_mem_ordering(false),
+      predecode_cache(kPredecodeEntries),
+      insn_cnt(0) {
   if (trace_log_path.length() != 0) {
     log = std::make_unique<log_file_t>(trace_log_path.c_str());
-    log_file = log->get();
   }
 
+#if !defined(OLD_SPIKE) && defined(COSIM_SIGSEGV_WORKAROUND)
+  isa_parser = new isa_parser_t(isa_string.c_str(), "MU");
+#elif !defined(OLD_SPIKE)
+  isa_parser = std::make_unique<isa_parser_t>(isa_string.c_str(), "MU");
+#endif
+
+  create_processor();
+}
+
+void SpikeCosim::create_processor() {
+  FILE *log_file = log ? log->get() : nullptr;
+
 #ifdef OLD_SPIKE
-  processor =
-      std::make_unique<processor_t>(isa_string.c_str(), "MU", DEFAULT_VARCH,
-                                    this, 0, false, log_file, std::cerr);
+  processor = std::make_unique<processor_t>(proc_config.isa_string.c_str(),
+                                            "MU", DEFAULT_VARCH, this,
+                                            proc_config.hart_id, false,
+                                            log_file, std::cerr);
 #else
 
 #ifdef COSIM_SIGSEGV_WORKAROUND
-  isa_parser = new isa_parser_t(isa_string.c_str(), "MU");
-  processor = std::make_unique<processor_t>(isa_parser, DEFAULT_VARCH, this, 0,
-                                            false, log_file, std::cerr);
+  processor = std::make_unique<processor_t>(isa_parser, DEFAULT_VARCH, this,
+                                            proc_config.hart_id, false,
+                                            log_file, std::cerr);
 #else
-  isa_parser = std::make_unique<isa_parser_t>(isa_string.c_str(), "MU");
-  processor = std::make_unique<processor_t>(
-      isa_parser.get(), DEFAULT_VARCH, this, 0, false, log_file, std::cerr);
+  processor = std::make_unique<processor_t>(isa_parser.get(), DEFAULT_VARCH,
+                                            this, proc_config.hart_id, false,
+                                            log_file, std::cerr);
 #endif
 
 #endif
 
-  processor->set_pmp_num(pmp_num_regions);
-  processor->set_mhpm_counter_num(mhpm_counter_num);
-  processor->set_pmp_granularity(1 << (pmp_granularity + 2));
-  processor->set_ibex_flags(secure_ibex, icache_en);
-  processor->set_debug_module_range(dm_start_addr, dm_end_addr);
+  processor->set_pmp_num(proc_config.pmp_num_regions);
+  processor->set_mhpm_counter_num(proc_config.mhpm_counter_num);
+  processor->set_pmp_granularity(1 << (proc_config.pmp_granularity + 2));
+  processor->set_ibex_flags(proc_config.secure_ibex, proc_config.icache_en);
+  processor->set_debug_module_range(proc_config.dm_start_addr,
+                                    proc_config.dm_end_addr);
 
-  initial_proc_setup(start_pc, start_mtvec, mhpm_counter_num);
+  initial_proc_setup(proc_config.start_pc, proc_config.start_mtvec,
+                     proc_config.mhpm_counter_num);
 
   if (log) {
     processor->set_debug(true);
@@ -78,12 +101,56 @@ SpikeCosim::SpikeCosim(const std::string &isa_string, uint32_t start_pc,
   }
 }
 
-// always return nullptr so all memory accesses go via mmio_load/mmio_store
-char *SpikeCosim::addr_to_mem(reg_t addr) { return nullptr; }
+void SpikeCosim::set_fast_fetch(bool enable) {
+  fast_fetch = enable;
+
+  // Drop any translations spike has cached so nothing obtained under the old
+  // setting is used
+  processor->get_mmu()->flush_tlb();
+}
+
+// Spike calls this when an access misses in its TLB. A pointer returned here is
+// cached by spike for the whole page, so further accesses of the same kind to
+// that page won't be seen by `mmio_load`/`mmio_store`. Return nullptr for
+// everything other than fast fetch instruction fetches so data accesses are
+// always checked against the DUT.
+char *SpikeCosim::addr_to_mem(reg_t addr) {
+  if (!fast_fetch || pending_iside_error) {
+    return nullptr;
+  }
+
+  // As in `mmio_load` use the PC to determine if this is an iside access
+  uint64_t pc = processor->get_state()->pc & 0xffffffff;
+  if (addr < pc || addr >= pc + 8) {
+    return nullptr;
+  }
+
+  // A load or store can access the bytes around its own PC. Spike would then
+  // cache the pointer for data accesses, so leave those to the slow path.
+  if (pc_is_mem_access(pc)) {
+    return nullptr;
+  }
+
+  auto desc = bus.find_device(addr);
+  SparseMem *mem = dynamic_cast<SparseMem *>(desc.second);
+  if (!mem || (addr - desc.first) >= mem->size()) {
+    return nullptr;
+  }
+
+  // Pages never written or shared with a snapshot give nullptr and are
+  // fetched via the slow path. Taking a pointer never moves a page, so pages
+  // only move in `bus_store`, which flushes the TLB of every hart sharing the
+  // memory when they do.
+  return mem->contents(addr - desc.first);
+}
 
 bool SpikeCosim::mmio_load(reg_t addr, size_t len, uint8_t *bytes) {
   bool bus_error = !bus.load(addr, len, bytes);
 
+  if (free_running) {
+    return !bus_error;
+  }
+
   bool dut_error = false;
 
   // Incoming access may be an iside or dside access. Use PC to help determine
@@ -103,6 +170,10 @@ bool SpikeCosim::mmio_load(reg_t addr, size_t len, uint8_t *bytes) {
     bool in_iside_range = (addr >= pc && addr < pc + 8);
 
     if (!in_iside_range) {
+      if (shared_mem_ordering && load_shared_mem_data(addr, len, bytes)) {
+        bus_error = false;
+      }
+
       dut_error = (check_mem_access(false, addr, len, bytes) != kCheckMemOk);
     }
   }
@@ -110,8 +181,37 @@ bool SpikeCosim::mmio_load(reg_t addr, size_t len, uint8_t *bytes) {
   return !(bus_error || dut_error);
 }
 
+// With shared memory ordering provide the data for an ISS load from the memory
+// contents captured when the DUT performed it, as another hart may have written
+// to it since. Returns false if there's no captured data for the access, if the
+// access doesn't match the pending DUT access `check_mem_access` will flag it.
+bool SpikeCosim::load_shared_mem_data(reg_t addr, size_t len, uint8_t *bytes) {
+  if (pending_dside_accesses.size() == 0) {
+    return false;
+  }
+
+  const PendingMemAccess &top_pending_access = pending_dside_accesses.front();
+  if (!top_pending_access.mem_data_valid ||
+      ((addr & 0xfffffffc) != top_pending_access.dut_access_info.addr) ||
+      (((addr & 0x3) + len) > 4)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < len; ++i) {
+    bytes[i] = top_pending_access.mem_data >> (((addr & 0x3) + i) * 8);
+  }
+
+  return true;
+}
+
 bool SpikeCosim::mmio_store(reg_t addr, size_t len, const uint8_t *bytes) {
-  bool bus_error = !bus.store(addr, len, bytes);
+  if (free_running) {
+    return bus_store(addr, len, bytes);
+  }
+
+  // With shared memory ordering DUT stores are written to memory when they're
+  // notified so the store doesn't need to be applied here.
+  bool bus_error = shared_mem_ordering ? false : !bus_store(addr, len, bytes);
   // If the RTL produced a bus error for the access, or the checking failed
   // produce a memory fault in spike.
   bool dut_error = (check_mem_access(true, addr, len, bytes) != kCheckMemOk);
@@ -124,14 +224,125 @@ void SpikeCosim::proc_reset(unsigned id) {}
 const char *SpikeCosim::get_symbol(uint64_t addr) { return nullptr; }
 
 void SpikeCosim::add_memory(uint32_t base_addr, size_t size) {
-  auto new_mem = std::make_unique<mem_t>(size);
-  bus.add_device(base_addr, new_mem.get());
-  mems.emplace_back(std::move(new_mem));
+  add_shared_memory(base_addr, std::make_shared<SparseMem>(size));
+}
+
+void SpikeCosim::add_shared_memory(uint32_t base_addr,
+                                   const std::shared_ptr<SparseMem> &mem) {
+  bus.add_device(base_addr, mem.get());
+  mems.push_back(mem);
+
+  // Instructions previously decoded from outside of any memory may now exist
+  flush_predecode();
+}
+
+size_t SpikeCosim::get_mem_pages_touched() {
+  size_t pages = 0;
+  for (auto &mem : mems) {
+    pages += mem->num_touched_pages();
+  }
+
+  return pages;
+}
+
+uint64_t SpikeCosim::run_free(uint64_t max_insns, bool use_stop_pc,
+                              uint32_t stop_pc) {
+  state_t *state = processor->get_state();
+  uint64_t retired = 0;
+  unsigned int steps_without_retire = 0;
+
+  free_running = true;
+
+  while (retired < max_insns) {
+    if (use_stop_pc && ((state->pc & 0xffffffff) == stop_pc)) {
+      break;
+    }
+
+    processor->step(1);
+
+    // A trap doesn't retire an instruction but the step after it does (see
+    // `step`), stop if spike doesn't make progress beyond that.
+    if (state->last_inst_pc != PC_INVALID) {
+      ++retired;
+      steps_without_retire = 0;
+    } else if (++steps_without_retire > 1) {
+      break;
+    }
+  }
+
+  free_running = false;
+  state->log_reg_write.clear();
+
+  return retired;
+}
+
+uint32_t SpikeCosim::get_pc() { return processor->get_state()->pc; }
+
+uint32_t SpikeCosim::get_gpr(int index) {
+  assert(index >= 0 && index < 32);
+
+  return processor->get_state()->XPR[index];
+}
+
+bool SpikeCosim::get_csr(int csr_num, uint32_t &val) {
+  auto &csrmap = processor->get_state()->csrmap;
+  auto csr = csrmap.find(csr_num);
+  if (csr == csrmap.end()) {
+    return false;
+  }
+
+  val = csr->second->read();
+  return true;
+}
+
+bool SpikeCosim::in_machine_mode() {
+  return (processor->get_state()->prv == PRV_M) &&
+         !processor->get_state()->debug_mode;
 }
 
 bool SpikeCosim::backdoor_write_mem(uint32_t addr, size_t len,
                                     const uint8_t *data_in) {
-  return bus.store(addr, len, data_in);
+  return bus_store(addr, len, data_in);
+}
+
+bool SpikeCosim::bus_store(reg_t addr, size_t len, const uint8_t *bytes) {
+  size_t page_copies = mem_page_copies();
+  bool success = bus.store(addr, len, bytes);
+  bool pages_moved = mem_page_copies() != page_copies;
+
+  if (shared_mem_harts.empty()) {
+    on_mem_write(addr, len, pages_moved);
+  } else {
+    for (SpikeCosim *hart : shared_mem_harts) {
+      hart->on_mem_write(addr, len, pages_moved);
+    }
+  }
+
+  return success;
+}
+
+void SpikeCosim::on_mem_write(reg_t addr, size_t len, bool pages_moved) {
+  invalidate_predecode(addr, len);
+
+  if (fast_fetch && pages_moved) {
+    // The store moved a page shared with a saved state, spike may hold a
+    // pointer to the old copy for fetches.
+    processor->get_mmu()->flush_tlb();
+  }
+}
+
+void SpikeCosim::set_shared_mem_harts(const std::vector<SpikeCosim *> &harts) {
+  shared_mem_harts = harts;
+  shared_mem_ordering = harts.size() > 1;
+}
+
+size_t SpikeCosim::mem_page_copies() {
+  size_t copies = 0;
+  for (auto &mem : mems) {
+    copies += mem->num_page_copies();
+  }
+
+  return copies;
 }
 
 bool SpikeCosim::backdoor_read_mem(uint32_t addr, size_t len,
@@ -262,11 +473,9 @@ bool SpikeCosim::step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
     // matches the reported dut behaviour.
     if (pending_sync_exception) {
       if (!sync_trap) {
-        std::stringstream err_str;
-        err_str << "Synchronous trap was expected at ISS PC: " << std::hex
-                << processor->get_state()->pc
-                << " but the DUT didn't report one at PC " << pc;
-        errors.emplace_back(err_str.str());
+        CosimMismatch &mismatch = add_mismatch(kCosimMismatchSyncTrapNotSeen);
+        mismatch.iss_pc = processor->get_state()->pc;
+        mismatch.dut_pc = pc;
         return false;
       }
 
@@ -295,10 +504,8 @@ bool SpikeCosim::step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
   }
 
   if (pending_iside_error) {
-    std::stringstream err_str;
-    err_str << "DUT generated an iside error for address: " << std::hex
-            << pending_iside_err_addr << " but the ISS didn't produce one";
-    errors.emplace_back(err_str.str());
+    add_mismatch(kCosimMismatchISideErrorNotSeen).addr =
+        pending_iside_err_addr;
     return false;
   }
   pending_iside_error = false;
@@ -313,11 +520,66 @@ bool SpikeCosim::step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
     return false;
   }
 
+  if (predecode(pc).flags & kPredecodeFenceI) {
+    // Stores already invalidate the predecode cache but flush it here too to
+    // match the architectural behaviour of fence.i.
+    flush_predecode();
+  }
+
   // Only increment insn_cnt and return true if there are no errors
   insn_cnt++;
   return true;
 }
 
+bool SpikeCosim::step_batch(const CosimEvent *events, size_t num_events,
+                            size_t &mismatch_idx) {
+  for (size_t i = 0; i < num_events; ++i) {
+    const CosimEvent &event = events[i];
+
+    switch (event.type) {
+      case kCosimEventStep:
+        if (!step(event.step.write_reg, event.step.write_reg_data,
+                  event.step.pc, event.step.sync_trap,
+                  event.step.suppress_reg_write)) {
+          mismatch_idx = i;
+          return false;
+        }
+        break;
+      case kCosimEventDSideAccess:
+        notify_dside_access(event.dside_access);
+        break;
+      case kCosimEventMip:
+        set_mip(event.mip.pre_mip, event.mip.post_mip);
+        break;
+      case kCosimEventNmi:
+        set_nmi(event.level);
+        break;
+      case kCosimEventNmiInt:
+        set_nmi_int(event.level);
+        break;
+      case kCosimEventDebugReq:
+        set_debug_req(event.level);
+        break;
+      case kCosimEventMcycle:
+        set_mcycle(event.mcycle);
+        break;
+      case kCosimEventCsr:
+        set_csr(event.csr.csr_num, event.csr.val);
+        break;
+      case kCosimEventIcScrKeyValid:
+        set_ic_scr_key_valid(event.level);
+        break;
+      case kCosimEventISideError:
+        set_iside_error(event.iside_err_addr);
+        break;
+      default:
+        assert(false);
+    }
+  }
+
+  return true;
+}
+
 bool SpikeCosim::check_retired_instr(uint32_t write_reg,
                                      uint32_t write_reg_data, uint32_t dut_pc,
                                      bool suppress_reg_write) {
@@ -328,11 +590,9 @@ bool SpikeCosim::check_retired_instr(uint32_t write_reg,
   // TODO: Confirm details of why spike sign extends PC, something to do with
   // 32-bit address as 64-bit address must be sign extended?
   if ((processor->get_state()->last_inst_pc & 0xffffffff) != dut_pc) {
-    std::stringstream err_str;
-    err_str << "PC mismatch, DUT retired : " << std::hex << dut_pc
-            << " , but the ISS retired: " << std::hex
-            << (processor->get_state()->last_inst_pc & 0xffffffff);
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchPc);
+    mismatch.dut_pc = dut_pc;
+    mismatch.iss_pc = processor->get_state()->last_inst_pc & 0xffffffff;
     return false;
   }
 
@@ -341,7 +601,7 @@ bool SpikeCosim::check_retired_instr(uint32_t write_reg,
 
   bool gpr_write_seen = false;
 
-  for (auto reg_change : reg_changes) {
+  for (const auto &reg_change : reg_changes) {
     // reg_change.first provides register type in bottom 4 bits, then register
     // index above that
 
@@ -370,16 +630,13 @@ bool SpikeCosim::check_retired_instr(uint32_t write_reg,
   }
 
   if (write_reg != 0 && !gpr_write_seen) {
-    std::stringstream err_str;
-    err_str << "DUT wrote register x" << write_reg
-            << " but a write was not expected" << std::endl;
-    errors.emplace_back(err_str.str());
+    add_mismatch(kCosimMismatchUnexpectedRegWrite).reg = write_reg;
     return false;
   }
 
   // Errors may have been generated outside of step()
   // (e.g. in check_mem_access()).
-  if (errors.size() != 0) {
+  if (!mismatches.empty()) {
     return false;
   }
 
@@ -393,21 +650,18 @@ bool SpikeCosim::check_sync_trap(uint32_t write_reg, uint32_t dut_pc,
 
   // Check that both spike and DUT trapped on the same pc
   if (initial_spike_pc != dut_pc) {
-    std::stringstream err_str;
-    err_str << "PC mismatch at synchronous trap, DUT at pc: " << std::hex
-            << dut_pc << "while ISS pc is at : " << std::hex
-            << initial_spike_pc;
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchSyncTrapPc);
+    mismatch.dut_pc = dut_pc;
+    mismatch.iss_pc = initial_spike_pc;
     return false;
   }
 
   // A sync trap should not have any side-effects, as the instruction appears on
   // the DUT RVFI but is not actually retired.
   if (write_reg != 0) {
-    std::stringstream err_str;
-    err_str << "Synchronous trap occurred at PC: " << std::hex << dut_pc
-            << "but DUT wrote to register: x" << std::dec << write_reg;
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchSyncTrapRegWrite);
+    mismatch.dut_pc = dut_pc;
+    mismatch.reg = write_reg;
     return false;
   }
 
@@ -425,7 +679,7 @@ bool SpikeCosim::check_sync_trap(uint32_t write_reg, uint32_t dut_pc,
 
   // Errors may have been generated outside of step() (e.g. in
   // check_mem_access()), return false if there are any.
-  if (errors.size() != 0) {
+  if (!mismatches.empty()) {
     return false;
   }
 
@@ -437,19 +691,15 @@ bool SpikeCosim::check_gpr_write(const commit_log_reg_t::value_type &reg_change,
   uint32_t cosim_write_reg = (reg_change.first >> 4) & 0x1f;
 
   if (write_reg == 0) {
-    std::stringstream err_str;
-    err_str << "DUT didn't write to register x" << cosim_write_reg
-            << ", but a write was expected";
-    errors.emplace_back(err_str.str());
+    add_mismatch(kCosimMismatchMissingRegWrite).reg = cosim_write_reg;
 
     return false;
   }
 
   if (write_reg != cosim_write_reg) {
-    std::stringstream err_str;
-    err_str << "Register write index mismatch, DUT: x" << write_reg
-            << " expected: x" << cosim_write_reg;
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchRegIndex);
+    mismatch.actual = write_reg;
+    mismatch.expected = cosim_write_reg;
 
     return false;
   }
@@ -460,11 +710,10 @@ bool SpikeCosim::check_gpr_write(const commit_log_reg_t::value_type &reg_change,
   uint32_t cosim_write_reg_data = reg_change.second.v[0];
 
   if (write_reg_data != cosim_write_reg_data) {
-    std::stringstream err_str;
-    err_str << "Register write data mismatch to x" << cosim_write_reg
-            << " DUT: " << std::hex << write_reg_data
-            << " expected: " << cosim_write_reg_data;
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchRegData);
+    mismatch.reg = cosim_write_reg;
+    mismatch.actual = write_reg_data;
+    mismatch.expected = cosim_write_reg_data;
 
     return false;
   }
@@ -475,21 +724,15 @@ bool SpikeCosim::check_gpr_write(const commit_log_reg_t::value_type &reg_change,
 bool SpikeCosim::check_suppress_reg_write(uint32_t write_reg, uint32_t pc,
                                           uint32_t &suppressed_write_reg) {
   if (write_reg != 0) {
-    std::stringstream err_str;
-    err_str << "Instruction at " << std::hex << pc
-            << " indicated a suppressed register write but wrote to x"
-            << std::dec << write_reg;
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchSuppressedRegWrite);
+    mismatch.dut_pc = pc;
+    mismatch.reg = write_reg;
 
     return false;
   }
 
   if (!pc_is_load(pc, suppressed_write_reg)) {
-    std::stringstream err_str;
-    err_str << "Instruction at " << std::hex << pc
-            << " indicated a suppressed register write is it not a load"
-               " only loads can suppress register writes";
-    errors.emplace_back(err_str.str());
+    add_mismatch(kCosimMismatchSuppressedNotLoad).dut_pc = pc;
 
     return false;
   }
@@ -617,12 +860,9 @@ void SpikeCosim::early_interrupt_handle() {
   processor->step(1);
 
   if (processor->get_state()->last_inst_pc != PC_INVALID) {
-    std::stringstream err_str;
-    err_str << "Attempted step for interrupt, expecting no instruction would "
-            << "be executed but saw one. PC before: " << std::hex
-            << initial_spike_pc
-            << " PC after: " << (processor->get_state()->pc & 0xffffffff);
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchInterruptStep);
+    mismatch.expected = initial_spike_pc;
+    mismatch.actual = processor->get_state()->pc & 0xffffffff;
   }
 }
 
@@ -662,11 +902,8 @@ void SpikeCosim::misaligned_pmp_fixup() {
                        top_pending_access_info.store ? STORE : LOAD,
                        top_pending_access_info.m_mode_access ? PRV_M : PRV_U)) {
         // Raise an error if the second half shouldn't have passed PMP
-        std::stringstream err_str;
-        err_str << "Saw second half of a misaligned access which not have "
-                << "generated a memory request as it does not pass a PMP check,"
-                << " address: " << std::hex << top_pending_access_info.addr;
-        errors.emplace_back(err_str.str());
+        add_mismatch(kCosimMismatchMisalignedPmp).addr =
+            top_pending_access_info.addr;
       } else {
         // Output warning on stdout so we're aware which tests this is happening
         // in
@@ -722,8 +959,12 @@ void SpikeCosim::set_debug_req(bool debug_req) {
 }
 
 void SpikeCosim::set_mcycle(uint64_t mcycle) {
-  uint32_t upper_mcycle = mcycle >> 32;
-  uint32_t lower_mcycle = mcycle & 0xffffffff;
+  write_counter64(CSR_MCYCLE, CSR_MCYCLEH, mcycle);
+}
+
+void SpikeCosim::write_counter64(int csr_num, int csr_num_h, uint64_t val) {
+  uint32_t upper_val = val >> 32;
+  uint32_t lower_val = val & 0xffffffff;
 
   // Spike decrements the MCYCLE CSR when you write to it to hack around an
   // issue it has with incorrectly setting minstret/mcycle when there's an
@@ -732,16 +973,16 @@ void SpikeCosim::set_mcycle(uint64_t mcycle) {
   // a time and get a decrement each time.
 
   // Write the lower half first, incremented twice due to the double decrement
-  processor->get_state()->csrmap[CSR_MCYCLE]->write(lower_mcycle + 2);
+  processor->get_state()->csrmap[csr_num]->write(lower_val + 2);
 
-  if ((processor->get_state()->csrmap[CSR_MCYCLE]->read() & 0xffffffff) == 0) {
+  if ((processor->get_state()->csrmap[csr_num]->read() & 0xffffffff) == 0) {
     // If the lower half is 0 at this point then the upper half will get
     // decremented, so increment it first.
-    upper_mcycle++;
+    upper_val++;
   }
 
   // Set the upper half
-  processor->get_state()->csrmap[CSR_MCYCLEH]->write(upper_mcycle);
+  processor->get_state()->csrmap[csr_num_h]->write(upper_val);
 
   // TODO: Do a neater job of this, a more recent spike release should allow us
   // to write all 64 bits at once at least.
@@ -765,8 +1006,28 @@ void SpikeCosim::notify_dside_access(const DSideAccessInfo &access_info) {
   // Address must be 32-bit aligned
   assert((access_info.addr & 0x3) == 0);
 
-  pending_dside_accesses.emplace_back(
-      PendingMemAccess{.dut_access_info = access_info, .be_spike = 0});
+  PendingMemAccess pending_access = {};
+  pending_access.dut_access_info = access_info;
+
+  if (shared_mem_ordering && !access_info.error) {
+    uint8_t bytes[4];
+    if (access_info.store) {
+      // Apply the store now so other harts see it in DUT order
+      for (int i = 0; i < 4; ++i) {
+        if (access_info.be & (1 << i)) {
+          bytes[0] = access_info.data >> (i * 8);
+          bus_store(access_info.addr + i, 1, bytes);
+        }
+      }
+    } else if (bus.load(access_info.addr, 4, bytes)) {
+      // Capture memory as the DUT saw it for when the ISS performs the load
+      pending_access.mem_data = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+                                (uint32_t(bytes[3]) << 24);
+      pending_access.mem_data_valid = true;
+    }
+  }
+
+  pending_dside_accesses.push_back(pending_access);
 }
 
 void SpikeCosim::set_iside_error(uint32_t addr) {
@@ -775,11 +1036,42 @@ void SpikeCosim::set_iside_error(uint32_t addr) {
 
   pending_iside_error = true;
   pending_iside_err_addr = addr;
+
+  if (fast_fetch) {
+    // The failing fetch may hit a page spike has cached a host pointer for,
+    // flush so it goes via `mmio_load` and sees the error.
+    processor->get_mmu()->flush_tlb();
+  }
+}
+
+const std::vector<CosimMismatch> &SpikeCosim::get_mismatches() {
+  return mismatches;
 }
 
-const std::vector<std::string> &SpikeCosim::get_errors() { return errors; }
+const std::vector<std::string> &SpikeCosim::get_errors() {
+  // Only format mismatches added since the last call, so strings already
+  // returned remain valid.
+  for (size_t i = error_strs.size(); i < mismatches.size(); ++i) {
+    error_strs.emplace_back(mismatches[i].to_string());
+  }
+
+  return error_strs;
+}
 
-void SpikeCosim::clear_errors() { errors.clear(); }
+void SpikeCosim::clear_errors() {
+  mismatches.clear();
+  error_strs.clear();
+}
+
+CosimMismatch &SpikeCosim::add_mismatch(CosimMismatchKind kind) {
+  mismatches.emplace_back();
+
+  CosimMismatch &mismatch = mismatches.back();
+  mismatch = CosimMismatch();
+  mismatch.kind = kind;
+
+  return mismatch;
+}
 
 void SpikeCosim::fixup_csr(int csr_num, uint32_t csr_val) {
   switch (csr_num) {
@@ -844,14 +1136,11 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
   // Expect that no spike memory accesses cross a 32-bit boundary
   assert(((addr + (len - 1)) & 0xfffffffc) == (addr & 0xfffffffc));
 
-  std::string iss_action = store ? "store" : "load";
-
   // Check if there are any pending DUT accesses to check against
   if (pending_dside_accesses.size() == 0) {
-    std::stringstream err_str;
-    err_str << "A " << iss_action << " at address " << std::hex << addr
-            << " was expected but there are no pending accesses";
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchMemNoPendingAccess);
+    mismatch.store = store;
+    mismatch.addr = addr;
 
     return kCheckMemCheckFailed;
   }
@@ -859,27 +1148,24 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
   auto &top_pending_access = pending_dside_accesses.front();
   auto &top_pending_access_info = top_pending_access.dut_access_info;
 
-  std::string dut_action = top_pending_access_info.store ? "store" : "load";
-
   // Check for an address match
   uint32_t aligned_addr = addr & 0xfffffffc;
   if (aligned_addr != top_pending_access_info.addr) {
-    std::stringstream err_str;
-    err_str << "DUT generated " << dut_action << " at address " << std::hex
-            << top_pending_access_info.addr << " but " << iss_action
-            << " at address " << aligned_addr << " was expected";
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchMemAddr);
+    mismatch.store = store;
+    mismatch.dut_store = top_pending_access_info.store;
+    mismatch.actual = top_pending_access_info.addr;
+    mismatch.expected = aligned_addr;
 
     return kCheckMemCheckFailed;
   }
 
   // Check access type match
   if (store != top_pending_access_info.store) {
-    std::stringstream err_str;
-    err_str << "DUT generated " << dut_action << " at addr " << std::hex
-            << top_pending_access_info.addr << " but a " << iss_action
-            << " was expected";
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchMemType);
+    mismatch.store = store;
+    mismatch.dut_store = top_pending_access_info.store;
+    mismatch.addr = top_pending_access_info.addr;
 
     return kCheckMemCheckFailed;
   }
@@ -899,14 +1185,13 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
     // Check bytes accessed this time haven't already been been seen for the DUT
     // access we are trying to match against
     if ((expected_be & top_pending_access.be_spike) != 0) {
-      std::stringstream err_str;
-      err_str << "DUT generated " << dut_action << " at address " << std::hex
-              << top_pending_access_info.addr << " with BE "
-              << top_pending_access_info.be << " and expected BE "
-              << expected_be << " has been seen twice, so far seen "
-              << top_pending_access.be_spike;
-
-      errors.emplace_back(err_str.str());
+      CosimMismatch &mismatch = add_mismatch(kCosimMismatchMemBeRepeated);
+      mismatch.store = store;
+      mismatch.dut_store = top_pending_access_info.store;
+      mismatch.addr = top_pending_access_info.addr;
+      mismatch.actual = top_pending_access_info.be;
+      mismatch.expected = expected_be;
+      mismatch.be_mask = top_pending_access.be_spike;
 
       return kCheckMemCheckFailed;
     }
@@ -914,12 +1199,12 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
     // Check expected access isn't trying to access bytes that the DUT access
     // didn't access.
     if ((expected_be & ~top_pending_access_info.be) != 0) {
-      std::stringstream err_str;
-      err_str << "DUT generated " << dut_action << " at address " << std::hex
-              << top_pending_access_info.addr << " with BE "
-              << top_pending_access_info.be << " but expected BE "
-              << expected_be << " has other bytes enabled";
-      errors.emplace_back(err_str.str());
+      CosimMismatch &mismatch = add_mismatch(kCosimMismatchMemBeExtra);
+      mismatch.store = store;
+      mismatch.dut_store = top_pending_access_info.store;
+      mismatch.addr = top_pending_access_info.addr;
+      mismatch.actual = top_pending_access_info.be;
+      mismatch.expected = expected_be;
       return kCheckMemCheckFailed;
     }
 
@@ -934,12 +1219,12 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
     // For aligned accesses bytes from spike access must precisely match bytes
     // from DUT access in one go
     if (expected_be != top_pending_access_info.be) {
-      std::stringstream err_str;
-      err_str << "DUT generated " << dut_action << " at address " << std::hex
-              << top_pending_access_info.addr << " with BE "
-              << top_pending_access_info.be << " but BE " << expected_be
-              << " was expected";
-      errors.emplace_back(err_str.str());
+      CosimMismatch &mismatch = add_mismatch(kCosimMismatchMemBe);
+      mismatch.store = store;
+      mismatch.dut_store = top_pending_access_info.store;
+      mismatch.addr = top_pending_access_info.addr;
+      mismatch.actual = top_pending_access_info.be;
+      mismatch.expected = expected_be;
 
       return kCheckMemCheckFailed;
     }
@@ -967,13 +1252,13 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
     uint32_t masked_dut_data = top_pending_access_info.data & expected_be_bits;
 
     if (expected_data != masked_dut_data) {
-      std::stringstream err_str;
-      err_str << "DUT generated " << iss_action << " at address " << std::hex
-              << top_pending_access_info.addr << " with data "
-              << masked_dut_data << " but data " << expected_data
-              << " was expected with byte mask " << expected_be;
-
-      errors.emplace_back(err_str.str());
+      CosimMismatch &mismatch = add_mismatch(kCosimMismatchMemData);
+      mismatch.store = store;
+      mismatch.dut_store = top_pending_access_info.store;
+      mismatch.addr = top_pending_access_info.addr;
+      mismatch.actual = masked_dut_data;
+      mismatch.expected = expected_data;
+      mismatch.be_mask = expected_be;
 
       return kCheckMemCheckFailed;
     }
@@ -992,12 +1277,11 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
       // Check the second access DUT exists
       if ((pending_dside_accesses.size() < 2) ||
           !pending_dside_accesses[1].dut_access_info.misaligned_second) {
-        std::stringstream err_str;
-        err_str << "DUT generated first half of misaligned " << iss_action
-                << " at address " << std::hex << top_pending_access_info.addr
-                << " but second half was expected and not seen";
-
-        errors.emplace_back(err_str.str());
+        CosimMismatch &mismatch =
+            add_mismatch(kCosimMismatchMisalignedSecondMissing);
+        mismatch.store = store;
+        mismatch.dut_store = top_pending_access_info.store;
+        mismatch.addr = top_pending_access_info.addr;
 
         return kCheckMemCheckFailed;
       }
@@ -1005,13 +1289,13 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
       // Check the second access had the expected address
       if (pending_dside_accesses[1].dut_access_info.addr !=
           (top_pending_access_info.addr + 4)) {
-        std::stringstream err_str;
-        err_str << "DUT generated first half of misaligned " << iss_action
-                << " at address " << std::hex << top_pending_access_info.addr
-                << " but second half had incorrect address "
-                << pending_dside_accesses[1].dut_access_info.addr;
-
-        errors.emplace_back(err_str.str());
+        CosimMismatch &mismatch =
+            add_mismatch(kCosimMismatchMisalignedSecondAddr);
+        mismatch.store = store;
+        mismatch.dut_store = top_pending_access_info.store;
+        mismatch.addr = top_pending_access_info.addr;
+        mismatch.actual = pending_dside_accesses[1].dut_access_info.addr;
+        mismatch.expected = top_pending_access_info.addr + 4;
 
         return kCheckMemCheckFailed;
       }
@@ -1036,17 +1320,112 @@ SpikeCosim::check_mem_result_e SpikeCosim::check_mem_access(
   return pending_access_error ? kCheckMemBusError : kCheckMemOk;
 }
 
-bool SpikeCosim::pc_is_mret(uint32_t pc) {
-  uint32_t insn;
+const SpikeCosim::PredecodedInsn &SpikeCosim::predecode(uint32_t pc) {
+  PredecodedInsn &entry =
+      predecode_cache[(pc >> 1) & (kPredecodeEntries - 1)];
 
-  if (!backdoor_read_mem(pc, 4, reinterpret_cast<uint8_t *>(&insn))) {
-    return false;
+  if ((entry.flags & kPredecodeValid) && (entry.pc == pc)) {
+    return entry;
+  }
+
+  entry.pc = pc;
+  entry.flags = kPredecodeValid;
+  entry.load_rd = 0;
+
+  uint16_t insn_16;
+  if (!backdoor_read_mem(pc, 2, reinterpret_cast<uint8_t *>(&insn_16))) {
+    return entry;
+  }
+
+  if ((insn_16 & 0x3) != 0x3) {
+    uint16_t insn_c = insn_16 & 0xE003;
+
+    if (insn_c == 0x4000) {
+      // C.LW
+      entry.flags |= kPredecodeLoad | kPredecodeMemAccess;
+      entry.load_rd = ((insn_16 >> 2) & 0x7) + 8;
+    } else if (insn_c == 0x4002) {
+      // C.LWSP, rd == 0 is reserved
+      entry.flags |= kPredecodeMemAccess;
+      entry.load_rd = (insn_16 >> 7) & 0x1F;
+      if (entry.load_rd != 0) {
+        entry.flags |= kPredecodeLoad;
+      }
+    } else if ((insn_c == 0xC000) || (insn_c == 0xC002)) {
+      // C.SW/C.SWSP
+      entry.flags |= kPredecodeMemAccess;
+    } else if (insn_16 == 0x9002) {
+      // C.EBREAK
+      entry.flags |= kPredecodeEbreak;
+    }
+
+    return entry;
+  }
+
+  // LOAD/STORE major opcodes
+  uint32_t opcode = insn_16 & 0x7F;
+  if ((opcode == 0x03) || (opcode == 0x23)) {
+    entry.flags |= kPredecodeMemAccess;
+  }
+
+  uint32_t insn_32;
+  if (!backdoor_read_mem(pc, 4, reinterpret_cast<uint8_t *>(&insn_32))) {
+    return entry;
+  }
+
+  if (opcode == 0x03) {
+    // LB/LH/LW/LBU/LHU
+    uint32_t func = (insn_32 >> 12) & 0x7;
+    // func 0x3, 0x6 and 0x7 are not valid load encodings
+    if ((func != 0x3) && (func != 0x6) && (func != 0x7)) {
+      entry.flags |= kPredecodeLoad;
+      entry.load_rd = (insn_32 >> 7) & 0x1F;
+    }
+  } else if (insn_32 == 0x30200073) {
+    entry.flags |= kPredecodeMret;
+  } else if (insn_32 == 0x00100073) {
+    entry.flags |= kPredecodeEbreak;
+  } else if ((insn_32 & 0x707F) == 0x100F) {
+    entry.flags |= kPredecodeFenceI;
+  }
+
+  return entry;
+}
+
+void SpikeCosim::invalidate_predecode(reg_t addr, size_t len) {
+  // Large writes (e.g. loading a binary) would touch every entry anyway
+  if (len >= kPredecodeEntries * 2) {
+    flush_predecode();
+    return;
+  }
+
+  // A 32-bit instruction starting up to 3 bytes before `addr` overlaps it
+  reg_t pc = addr >= 3 ? (addr - 3) & ~reg_t(1) : 0;
+  for (; pc < addr + len; pc += 2) {
+    PredecodedInsn &entry =
+        predecode_cache[(pc >> 1) & (kPredecodeEntries - 1)];
+
+    if (entry.pc == pc) {
+      entry.flags = 0;
+    }
+  }
+}
+
+void SpikeCosim::flush_predecode() {
+  for (auto &entry : predecode_cache) {
+    entry.flags = 0;
   }
+}
 
-  return insn == 0x30200073;
+bool SpikeCosim::pc_is_mret(uint32_t pc) {
+  return predecode(pc).flags & kPredecodeMret;
 }
 
 bool SpikeCosim::pc_is_debug_ebreak(uint32_t pc) {
+  if (!(predecode(pc).flags & kPredecodeEbreak)) {
+    return false;
+  }
+
   uint32_t dcsr = processor->get_csr(CSR_DCSR);
 
   // ebreak debug entry is controlled by the ebreakm (bit 15) and ebreaku (bit
@@ -1057,23 +1436,7 @@ bool SpikeCosim::pc_is_debug_ebreak(uint32_t pc) {
     return false;
   }
 
-  // First check for 16-bit c.ebreak
-  uint16_t insn_16;
-  if (!backdoor_read_mem(pc, 2, reinterpret_cast<uint8_t *>(&insn_16))) {
-    return false;
-  }
-
-  if (insn_16 == 0x9002) {
-    return true;
-  }
-
-  // Not a c.ebreak, check for 32 bit ebreak
-  uint32_t insn_32;
-  if (!backdoor_read_mem(pc, 4, reinterpret_cast<uint8_t *>(&insn_32))) {
-    return false;
-  }
-
-  return insn_32 == 0x00100073;
+  return true;
 }
 
 bool SpikeCosim::check_debug_ebreak(uint32_t write_reg, uint32_t pc,
@@ -1082,20 +1445,15 @@ bool SpikeCosim::check_debug_ebreak(uint32_t write_reg, uint32_t pc,
   // 'sync_trap' (though doesn't act like a trap in various respects).
 
   if (write_reg != 0) {
-    std::stringstream err_str;
-    err_str << "DUT executed ebreak at " << std::hex << pc
-            << " but also wrote register x" << std::dec << write_reg
-            << " which was unexpected";
-    errors.emplace_back(err_str.str());
+    CosimMismatch &mismatch = add_mismatch(kCosimMismatchEbreakRegWrite);
+    mismatch.dut_pc = pc;
+    mismatch.reg = write_reg;
 
     return false;
   }
 
   if (sync_trap) {
-    std::stringstream err_str;
-    err_str << "DUT executed ebreak into debug at " << std::hex << pc
-            << " but indicated a synchronous trap, which was unexpected";
-    errors.emplace_back(err_str.str());
+    add_mismatch(kCosimMismatchEbreakSyncTrap).dut_pc = pc;
 
     return false;
   }
@@ -1104,43 +1462,324 @@ bool SpikeCosim::check_debug_ebreak(uint32_t write_reg, uint32_t pc,
 }
 
 bool SpikeCosim::pc_is_load(uint32_t pc, uint32_t &rd_out) {
-  uint16_t insn_16;
+  const PredecodedInsn &insn = predecode(pc);
 
-  if (!backdoor_read_mem(pc, 2, reinterpret_cast<uint8_t *>(&insn_16))) {
+  if (!(insn.flags & kPredecodeLoad)) {
+    return false;
+  }
+
+  rd_out = insn.load_rd;
+  return true;
+}
+
+bool SpikeCosim::pc_is_mem_access(uint32_t pc) {
+  return predecode(pc).flags & kPredecodeMemAccess;
+}
+
+unsigned int SpikeCosim::get_insn_cnt() { return insn_cnt; }
+
+class SpikeCosim::State : public CosimState {
+ public:
+  // Processor state
+  reg_t xpr[32];
+  reg_t pc;
+  reg_t prv;
+  bool debug_mode;
+  bool nmi;
+  bool nmi_int;
+  reg_t last_inst_pc;
+  int single_step;
+  int halt_request;
+  std::vector<std::pair<reg_t, reg_t>> csrs;
+  std::vector<std::pair<reg_t, reg_t>> triggers;
+  uint64_t mcycle;
+  uint64_t minstret;
+  reg_t mip;
+
+  // SpikeCosim state
+  bool nmi_mode;
+  mstack_t mstack;
+  std::vector<PendingMemAccess> pending_dside_accesses;
+  bool pending_iside_error;
+  uint32_t pending_iside_err_addr;
+  unsigned int insn_cnt;
+
+  std::vector<SparseMem::Snapshot> mems;
+};
+
+// CSRs that cannot be restored by a simple write in `restore_state`. Counters
+// and MIP have dedicated handling, PMP CSRs must be written in a particular
+// order, trigger CSRs are accessed via the trigger module and the user mode
+// counters are read-only views of the machine mode counters.
+static bool csr_needs_ordered_restore(reg_t csr_num) {
+  return (csr_num == CSR_MCYCLE) || (csr_num == CSR_MCYCLEH) ||
+         (csr_num == CSR_MINSTRET) || (csr_num == CSR_MINSTRETH) ||
+         (csr_num == CSR_MIP) ||
+         ((csr_num >= CSR_PMPCFG0) && (csr_num < CSR_PMPADDR0 + 64)) ||
+         (csr_num == CSR_MSECCFG) || (csr_num == CSR_MSECCFGH) ||
+         ((csr_num >= CSR_TDATA1) && (csr_num <= CSR_TDATA3)) ||
+         ((csr_num >= CSR_CYCLE) && (csr_num <= CSR_HPMCOUNTER31)) ||
+         ((csr_num >= CSR_CYCLEH) && (csr_num <= CSR_HPMCOUNTER31H));
+}
+
+static bool csr_is_pmp_addr(reg_t csr_num) {
+  return (csr_num >= CSR_PMPADDR0) && (csr_num < CSR_PMPADDR0 + 64);
+}
+
+static bool csr_is_pmp_cfg(reg_t csr_num) {
+  return (csr_num >= CSR_PMPCFG0) && (csr_num < CSR_PMPCFG0 + 16);
+}
+
+std::unique_ptr<CosimState> SpikeCosim::save_state() {
+  auto saved = std::make_unique<State>();
+  state_t *state = processor->get_state();
+
+  for (int i = 0; i < 32; ++i) {
+    saved->xpr[i] = state->XPR[i];
+  }
+
+  saved->pc = state->pc;
+  saved->prv = state->prv;
+  saved->debug_mode = state->debug_mode;
+  saved->nmi = state->nmi;
+  saved->nmi_int = state->nmi_int;
+  saved->last_inst_pc = state->last_inst_pc;
+  saved->single_step = state->single_step;
+  saved->halt_request = processor->halt_request;
+
+  for (auto &csr : state->csrmap) {
+    saved->csrs.emplace_back(csr.first, csr.second->read());
+  }
+
+  for (unsigned i = 0; i < processor->TM.count(); ++i) {
+    saved->triggers.emplace_back(processor->TM.tdata1_read(processor.get(), i),
+                                 processor->TM.tdata2_read(processor.get(), i));
+  }
+
+  saved->mcycle =
+      processor->get_csr(CSR_MCYCLE) |
+      (static_cast<uint64_t>(processor->get_csr(CSR_MCYCLEH)) << 32);
+  saved->minstret =
+      processor->get_csr(CSR_MINSTRET) |
+      (static_cast<uint64_t>(processor->get_csr(CSR_MINSTRETH)) << 32);
+  saved->mip = state->mip->read();
+
+  saved->nmi_mode = nmi_mode;
+  saved->mstack = mstack;
+  saved->pending_dside_accesses = pending_dside_accesses;
+  saved->pending_iside_error = pending_iside_error;
+  saved->pending_iside_err_addr = pending_iside_err_addr;
+  saved->insn_cnt = insn_cnt;
+
+  for (auto &mem : mems) {
+    saved->mems.push_back(mem->save());
+  }
+
+  return saved;
+}
+
+// Spike has no way to copy processor state wholesale, so a fresh processor is
+// built and the saved state written to it. Starting from a fresh processor
+// means locked PMP regions or debug mode only triggers in the current
+// processor cannot block writes of the saved state.
+bool SpikeCosim::restore_state(const CosimState &cosim_state) {
+  const State *saved = dynamic_cast<const State *>(&cosim_state);
+  if (!saved || saved->mems.size() != mems.size()) {
     return false;
   }
 
-  // C.LW
-  if ((insn_16 & 0xE003) == 0x4000) {
-    rd_out = ((insn_16 >> 2) & 0x7) + 8;
-    return true;
+  create_processor();
+  state_t *state = processor->get_state();
+
+  // Triggers in debug mode only can only be written from debug mode
+  state->debug_mode = true;
+  for (unsigned i = 0; i < saved->triggers.size(); ++i) {
+    processor->TM.tdata2_write(processor.get(), i, saved->triggers[i].second);
+    processor->TM.tdata1_write(processor.get(), i, saved->triggers[i].first);
+  }
+
+  for (auto &csr : saved->csrs) {
+    if (!csr_needs_ordered_restore(csr.first)) {
+      set_csr(csr.first, csr.second);
+    }
+  }
+
+  // PMP addresses must be written before the configuration that may lock them,
+  // with mseccfg (which can stop the configuration being written) last.
+  for (auto &csr : saved->csrs) {
+    if (csr_is_pmp_addr(csr.first)) {
+      set_csr(csr.first, csr.second);
+    }
   }
 
-  // C.LWSP
-  if ((insn_16 & 0xE003) == 0x4002) {
-    rd_out = (insn_16 >> 7) & 0x1F;
-    return rd_out != 0;
+  for (auto &csr : saved->csrs) {
+    if (csr_is_pmp_cfg(csr.first)) {
+      set_csr(csr.first, csr.second);
+    }
   }
 
-  uint16_t insn_32;
+  for (auto &csr : saved->csrs) {
+    if ((csr.first == CSR_MSECCFG) || (csr.first == CSR_MSECCFGH)) {
+      set_csr(csr.first, csr.second);
+    }
+  }
 
-  if (!backdoor_read_mem(pc, 4, reinterpret_cast<uint8_t *>(&insn_32))) {
+  write_counter64(CSR_MCYCLE, CSR_MCYCLEH, saved->mcycle);
+  write_counter64(CSR_MINSTRET, CSR_MINSTRETH, saved->minstret);
+  state->mip->write_with_mask(0xffffffff, saved->mip);
+
+  for (int i = 1; i < 32; ++i) {
+    state->XPR.write(i, saved->xpr[i]);
+  }
+
+  state->pc = saved->pc;
+  state->prv = saved->prv;
+  state->debug_mode = saved->debug_mode;
+  state->nmi = saved->nmi;
+  state->nmi_int = saved->nmi_int;
+  state->last_inst_pc = saved->last_inst_pc;
+  state->single_step = static_cast<decltype(state->single_step)>(
+      saved->single_step);
+  processor->halt_request =
+      static_cast<decltype(processor->halt_request)>(saved->halt_request);
+
+  // None of the restore writes above should be reported as register writes
+  state->log_reg_write.clear();
+
+  nmi_mode = saved->nmi_mode;
+  mstack = saved->mstack;
+  pending_dside_accesses = saved->pending_dside_accesses;
+  pending_iside_error = saved->pending_iside_error;
+  pending_iside_err_addr = saved->pending_iside_err_addr;
+  insn_cnt = saved->insn_cnt;
+
+  for (size_t i = 0; i < mems.size(); ++i) {
+    mems[i]->restore(saved->mems[i]);
+  }
+
+  flush_predecode();
+
+  return true;
+}
+
+template <typename T>
+static void write_pod(std::ostream &out, const T &val) {
+  out.write(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template <typename T>
+static void read_pod(std::istream &in, T &val) {
+  in.read(reinterpret_cast<char *>(&val), sizeof(T));
+}
+
+template <typename T>
+static void write_vector(std::ostream &out, const std::vector<T> &vec) {
+  write_pod(out, static_cast<uint64_t>(vec.size()));
+  out.write(reinterpret_cast<const char *>(vec.data()), vec.size() * sizeof(T));
+}
+
+template <typename T>
+static bool read_vector(std::istream &in, std::vector<T> &vec) {
+  uint64_t size = 0;
+  read_pod(in, size);
+  // Guard against a corrupt length leading to a huge allocation
+  if (!in.good() || size > (1 << 20)) {
     return false;
   }
 
-  // LB/LH/LW/LBU/LHU
-  if ((insn_32 & 0x7F) == 0x3) {
-    uint32_t func = (insn_32 >> 12) & 0x7;
-    if ((func == 0x3) || (func == 0x6) || (func == 0x7)) {
-      // Not valid load encodings
+  vec.resize(size);
+  in.read(reinterpret_cast<char *>(vec.data()), size * sizeof(T));
+
+  return in.good();
+}
+
+// State is written in host byte order and layout, it is only intended to be
+// read back by the same build of the co-simulator.
+static const char kStateMagic[8] = {'I', 'B', 'X', 'C', 'O', 'S', 'M', '1'};
+
+bool SpikeCosim::write_state(const CosimState &cosim_state, std::ostream &out) {
+  const State *saved = dynamic_cast<const State *>(&cosim_state);
+  if (!saved || saved->mems.size() != mems.size()) {
+    return false;
+  }
+
+  out.write(kStateMagic, sizeof(kStateMagic));
+
+  write_pod(out, saved->xpr);
+  write_pod(out, saved->pc);
+  write_pod(out, saved->prv);
+  write_pod(out, saved->debug_mode);
+  write_pod(out, saved->nmi);
+  write_pod(out, saved->nmi_int);
+  write_pod(out, saved->last_inst_pc);
+  write_pod(out, saved->single_step);
+  write_pod(out, saved->halt_request);
+  write_vector(out, saved->csrs);
+  write_vector(out, saved->triggers);
+  write_pod(out, saved->mcycle);
+  write_pod(out, saved->minstret);
+  write_pod(out, saved->mip);
+
+  write_pod(out, saved->nmi_mode);
+  write_pod(out, saved->mstack);
+  write_vector(out, saved->pending_dside_accesses);
+  write_pod(out, saved->pending_iside_error);
+  write_pod(out, saved->pending_iside_err_addr);
+  write_pod(out, saved->insn_cnt);
+
+  for (size_t i = 0; i < mems.size(); ++i) {
+    if (!mems[i]->write_snapshot(saved->mems[i], out)) {
       return false;
     }
-
-    rd_out = (insn_32 >> 7) & 0x1F;
-    return true;
   }
 
-  return false;
+  return out.good();
 }
 
-unsigned int SpikeCosim::get_insn_cnt() { return insn_cnt; }
+std::unique_ptr<CosimState> SpikeCosim::read_state(std::istream &in) {
+  char magic[sizeof(kStateMagic)];
+  in.read(magic, sizeof(magic));
+  if (!in.good() || !std::equal(magic, magic + sizeof(magic), kStateMagic)) {
+    return nullptr;
+  }
+
+  auto saved = std::make_unique<State>();
+
+  read_pod(in, saved->xpr);
+  read_pod(in, saved->pc);
+  read_pod(in, saved->prv);
+  read_pod(in, saved->debug_mode);
+  read_pod(in, saved->nmi);
+  read_pod(in, saved->nmi_int);
+  read_pod(in, saved->last_inst_pc);
+  read_pod(in, saved->single_step);
+  read_pod(in, saved->halt_request);
+  if (!read_vector(in, saved->csrs) || !read_vector(in, saved->triggers)) {
+    return nullptr;
+  }
+  read_pod(in, saved->mcycle);
+  read_pod(in, saved->minstret);
+  read_pod(in, saved->mip);
+
+  read_pod(in, saved->nmi_mode);
+  read_pod(in, saved->mstack);
+  if (!read_vector(in, saved->pending_dside_accesses)) {
+    return nullptr;
+  }
+  read_pod(in, saved->pending_iside_error);
+  read_pod(in, saved->pending_iside_err_addr);
+  read_pod(in, saved->insn_cnt);
+
+  for (auto &mem : mems) {
+    saved->mems.emplace_back();
+    if (!mem->read_snapshot(in, saved->mems.back())) {
+      return nullptr;
+    }
+  }
+
+  if (!in.good()) {
+    return nullptr;
+  }
+
+  return saved;
+}
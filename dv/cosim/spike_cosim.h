@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "cosim.h"
+#include "sparse_mem.h"
 #include "riscv/devices.h"
 #include "riscv/log_file.h"
 #include "riscv/processor.h"
@@ -35,9 +36,35 @@ class SpikeCosim : public simif_t, public Cosim {
 #endif
   std::unique_ptr<processor_t> processor;
   std::unique_ptr<log_file_t> log;
+
+  // Configuration used to build `processor`, kept so a fresh processor can be
+  // built when restoring state
+  struct ProcessorConfig {
+    std::string isa_string;
+    uint32_t start_pc;
+    uint32_t start_mtvec;
+    bool secure_ibex;
+    bool icache_en;
+    uint32_t pmp_num_regions;
+    uint32_t pmp_granularity;
+    uint32_t mhpm_counter_num;
+    uint32_t dm_start_addr;
+    uint32_t dm_end_addr;
+    uint32_t hart_id;
+  };
+
+  ProcessorConfig proc_config;
+
+  // Saved state, see `save_state`
+  class State;
+
   bus_t bus;
-  std::vector<std::unique_ptr<mem_t>> mems;
-  std::vector<std::string> errors;
+  std::vector<std::shared_ptr<SparseMem>> mems;
+  // Mismatches seen so far and the descriptions of them formatted by
+  // `get_errors`. Descriptions are only formatted on request so the checking
+  // done each `step` never has to build strings.
+  std::vector<CosimMismatch> mismatches;
+  std::vector<std::string> error_strs;
   bool nmi_mode;
 
   typedef struct {
@@ -54,6 +81,10 @@ class SpikeCosim : public simif_t, public Cosim {
   struct PendingMemAccess {
     DSideAccessInfo dut_access_info;
     uint32_t be_spike;
+    // With `shared_mem_ordering` the memory contents for a load when the DUT
+    // access was seen, if `mem_data_valid` is set
+    uint32_t mem_data;
+    bool mem_data_valid;
   };
 
   std::vector<PendingMemAccess> pending_dside_accesses;
@@ -61,17 +92,70 @@ class SpikeCosim : public simif_t, public Cosim {
   bool pending_iside_error;
   uint32_t pending_iside_err_addr;
 
+  // When set instruction fetches are served directly from host memory via
+  // `addr_to_mem`, see `set_fast_fetch`
+  bool fast_fetch;
+
+  // When set spike runs without checking against the DUT, see `run_free`
+  bool free_running;
+
+  // When set memory is shared with other harts, see `set_shared_mem_harts`
+  bool shared_mem_ordering;
+  std::vector<SpikeCosim *> shared_mem_harts;
+
   typedef enum {
     kCheckMemOk,           // Checks passed and access succeeded in RTL
     kCheckMemCheckFailed,  // Checks failed
     kCheckMemBusError  // Checks passed, but access generated bus error in RTL
   } check_mem_result_e;
 
+  // Record a new mismatch of the given kind, returning it so the caller can
+  // fill in the relevant details
+  CosimMismatch &add_mismatch(CosimMismatchKind kind);
+
   check_mem_result_e check_mem_access(bool store, uint32_t addr, size_t len,
                                       const uint8_t *bytes);
 
+  // Store to memory via `bus`, dealing with any effect on spike's TLB
+  bool bus_store(reg_t addr, size_t len, const uint8_t *bytes);
+  size_t mem_page_copies();
+  bool load_shared_mem_data(reg_t addr, size_t len, uint8_t *bytes);
+  // Deal with a write to memory, possibly by another hart sharing it.
+  // `pages_moved` indicates the write copied a page shared with a snapshot.
+  void on_mem_write(reg_t addr, size_t len, bool pages_moved);
+
+  // Classification of the instruction at a PC, see `predecode`
+  struct PredecodedInsn {
+    uint32_t pc;
+    uint8_t flags;
+    // Destination register when `kPredecodeLoad` is set
+    uint8_t load_rd;
+  };
+
+  enum {
+    kPredecodeValid = 1 << 0,
+    kPredecodeMret = 1 << 1,
+    kPredecodeEbreak = 1 << 2,
+    kPredecodeLoad = 1 << 3,
+    kPredecodeMemAccess = 1 << 4,
+    kPredecodeFenceI = 1 << 5
+  };
+
+  // Direct mapped cache of predecoded instructions indexed by PC. Entries are
+  // invalidated by any write to the memory they were decoded from.
+  static constexpr size_t kPredecodeEntries = 4096;
+  std::vector<PredecodedInsn> predecode_cache;
+
+  // Return the classification of the instruction at `pc`, decoding it from
+  // memory if it isn't already in `predecode_cache`
+  const PredecodedInsn &predecode(uint32_t pc);
+  // Invalidate any cached instructions overlapping `addr` to `addr + len - 1`
+  void invalidate_predecode(reg_t addr, size_t len);
+  void flush_predecode();
+
   bool pc_is_mret(uint32_t pc);
   bool pc_is_load(uint32_t pc, uint32_t &rd_out);
+  bool pc_is_mem_access(uint32_t pc);
 
   bool pc_is_debug_ebreak(uint32_t pc);
   bool check_debug_ebreak(uint32_t write_reg, uint32_t pc, bool sync_trap);
@@ -90,9 +174,13 @@ class SpikeCosim : public simif_t, public Cosim {
   void set_cpuctrlsts_double_fault_seen();
   void handle_cpuctrl_exception_entry();
 
+  void create_processor();
   void initial_proc_setup(uint32_t start_pc, uint32_t start_mtvec,
                           uint32_t mhpm_counter_num);
 
+  // Write a 64-bit counter split across two CSRs (e.g. mcycle/mcycleh)
+  void write_counter64(int csr_num, int csr_num_h, uint64_t val);
+
   void early_interrupt_handle();
 
   void misaligned_pmp_fixup();
@@ -104,7 +192,53 @@ class SpikeCosim : public simif_t, public Cosim {
              uint32_t start_mtvec, const std::string &trace_log_path,
              bool secure_ibex, bool icache_en, uint32_t pmp_num_regions,
              uint32_t pmp_granularity, uint32_t mhpm_counter_num,
-             uint32_t dm_start_addr, uint32_t dm_end_addr);
+             uint32_t dm_start_addr, uint32_t dm_end_addr,
+             uint32_t hart_id = 0);
+
+  // Enable or disable the fast fetch path.
+  //
+  // By default every access spike makes goes via `mmio_load`/`mmio_store`,
+  // which means spike cannot cache any memory translations. With fast fetch
+  // enabled, instruction fetches are given a direct pointer into the
+  // co-simulator memory so spike's TLB and instruction cache can serve them.
+  // Loads and stores still always go via `mmio_load`/`mmio_store` so they're
+  // checked against the accesses seen from the DUT.
+  void set_fast_fetch(bool enable);
+
+  // Number of pages of co-simulator memory that have been written, see
+  // `SparseMem`
+  size_t get_mem_pages_touched();
+
+  // Run spike on its own, without checking against the DUT, e.g. to
+  // fast-forward through the start of a program. Loads and stores access
+  // co-simulator memory directly. Runs until `max_insns` instructions have
+  // retired, the PC reaches `stop_pc` (if `use_stop_pc` is set) or spike stops
+  // retiring instructions (e.g. waiting for an interrupt). Returns the number
+  // of instructions retired.
+  uint64_t run_free(uint64_t max_insns, bool use_stop_pc, uint32_t stop_pc);
+
+  // Architectural state, e.g. to transfer to the DUT after `run_free`.
+  // `get_csr` returns false if the CSR doesn't exist.
+  uint32_t get_pc();
+  uint32_t get_gpr(int index);
+  bool get_csr(int csr_num, uint32_t &val);
+  bool in_machine_mode();
+
+  // Add a memory that may also be added to other `SpikeCosim` instances
+  void add_shared_memory(uint32_t base_addr,
+                         const std::shared_ptr<SparseMem> &mem);
+
+  // Set the harts (including this one) that memory is shared with, see
+  // `MultiHartCosim`. Writes from any of them are seen by all of them.
+  //
+  // With more than one hart memory ordering between them follows the order
+  // the DUT accesses were seen, rather than the order instructions are stepped
+  // in. DUT stores are applied to memory when notified with
+  // `notify_dside_access` and loads are checked against the memory contents
+  // at that point. As long as accesses from all harts are notified in the
+  // order they happened, a hart stepping a load after another hart's later
+  // store still sees the value the DUT saw.
+  void set_shared_mem_harts(const std::vector<SpikeCosim *> &harts);
 
   // simif_t implementation
   virtual char *addr_to_mem(reg_t addr) override;
@@ -121,6 +255,8 @@ class SpikeCosim : public simif_t, public Cosim {
   bool backdoor_read_mem(uint32_t addr, size_t len, uint8_t *data_out) override;
   bool step(uint32_t write_reg, uint32_t write_reg_data, uint32_t pc,
             bool sync_trap, bool suppress_reg_write) override;
+  bool step_batch(const CosimEvent *events, size_t num_events,
+                  size_t &mismatch_idx) override;
 
   bool check_retired_instr(uint32_t write_reg, uint32_t write_reg_data,
                            uint32_t dut_pc, bool suppress_reg_write);
@@ -140,9 +276,14 @@ class SpikeCosim : public simif_t, public Cosim {
   // will break.
   // TODO: Work on spike changes to remove this restriction
   void set_iside_error(uint32_t addr) override;
+  const std::vector<CosimMismatch> &get_mismatches() override;
   const std::vector<std::string> &get_errors() override;
   void clear_errors() override;
   unsigned int get_insn_cnt() override;
+  std::unique_ptr<CosimState> save_state() override;
+  bool restore_state(const CosimState &state) override;
+  bool write_state(const CosimState &state, std::ostream &out) override;
+  std::unique_ptr<CosimState> read_state(std::istream &in) override;
 };
 
 #endif  // SPIKE_COSIM_H_
@@ -42,6 +42,8 @@ class ibex_cosim_agent extends uvm_agent;
   endfunction: connect_phase
 
   function void write_mem_byte(bit [31:0] addr, bit [7:0] d);
+    // Earlier events must reach the cosim before memory contents change underneath it
+    scoreboard.flush_cosim_events();
     riscv_cosim_write_mem_byte(scoreboard.cosim_handle, addr, d);
   endfunction
 
@@ -16,6 +16,17 @@ class core_ibex_cosim_cfg extends uvm_object;
   bit        icache;
   bit [31:0] dm_start_addr;
   bit [31:0] dm_end_addr;
+  // Serve instruction fetches from host memory in spike rather than via MMIO, see
+  // `SpikeCosim::set_fast_fetch`.
+  bit        fast_fetch;
+  // Run the cosim on a separate thread, see `AsyncCosim`
+  bit        async_cosim;
+  // When not empty record a trace of the cosim to this file so checking can be re-run offline with
+  // `cosim_replay`, see dv/cosim/README.md
+  string     trace_file;
+  // Number of events (retired instructions, interrupt changes, memory accesses etc) queued
+  // before they're handed to the cosim in one DPI call. 1 checks each event as it is seen.
+  int unsigned cosim_batch_events = 1;
 
   `uvm_object_utils_begin(core_ibex_cosim_cfg)
     `uvm_field_string(isa_string, UVM_DEFAULT)
@@ -30,6 +41,10 @@ class core_ibex_cosim_cfg extends uvm_object;
     `uvm_field_int(icache, UVM_DEFAULT)
     `uvm_field_int(dm_start_addr, UVM_DEFAULT | UVM_HEX)
     `uvm_field_int(dm_end_addr, UVM_DEFAULT | UVM_HEX)
+    `uvm_field_int(cosim_batch_events, UVM_DEFAULT)
+    `uvm_field_int(fast_fetch, UVM_DEFAULT)
+    `uvm_field_int(async_cosim, UVM_DEFAULT)
+    `uvm_field_string(trace_file, UVM_DEFAULT)
   `uvm_object_utils_end
 
   `uvm_object_new
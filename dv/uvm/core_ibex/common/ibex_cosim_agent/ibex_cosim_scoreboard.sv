@@ -32,6 +32,12 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
 
   iside_err_t iside_error_queue [$];
 
+  // Events waiting to be handed to the cosim in a single `riscv_cosim_step_batch` call, along
+  // with the time each one was seen. See `cosim_batch_events` in the cosim configuration.
+  bit [95:0] cosim_events      [];
+  time       cosim_event_times [];
+  int        num_cosim_events;
+
   `uvm_component_utils(ibex_cosim_scoreboard)
 
   function new(string name="", uvm_component parent=null);
@@ -76,11 +82,23 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
     // TODO: Ensure log file on reset gets append rather than overwrite?
     cosim_handle = spike_cosim_init(cfg.isa_string, cfg.start_pc, cfg.start_mtvec, cfg.log_file,
       cfg.pmp_num_regions, cfg.pmp_granularity, cfg.mhpm_counter_num, cfg.secure_ibex, cfg.icache,
-      cfg.dm_start_addr, cfg.dm_end_addr);
+      cfg.dm_start_addr, cfg.dm_end_addr, cfg.trace_file);
 
     if (cosim_handle == null) begin
       `uvm_fatal(`gfn, "Could not initialise cosim")
     end
+
+    spike_cosim_set_fast_fetch(cosim_handle, cfg.fast_fetch);
+
+    if (cfg.async_cosim) begin
+      cosim_handle = spike_cosim_make_async(cosim_handle);
+    end
+
+    `DV_CHECK_FATAL(cfg.cosim_batch_events > 0, "Cosim event batch size configured to zero.")
+
+    cosim_events      = new[cfg.cosim_batch_events];
+    cosim_event_times = new[cfg.cosim_batch_events];
+    num_cosim_events  = 0;
   endfunction
 
   protected function void cleanup_cosim();
@@ -122,9 +140,9 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
       if (rvfi_instr.irq_only) begin
         // RVFI item is only notifying about new interrupts, not a retired instruction, so provide
         // cosim with interrupt information and loop back to await the next item.
-        riscv_cosim_set_nmi(cosim_handle, rvfi_instr.nmi);
-        riscv_cosim_set_nmi_int(cosim_handle, rvfi_instr.nmi_int);
-        riscv_cosim_set_mip(cosim_handle, rvfi_instr.pre_mip, rvfi_instr.pre_mip);
+        add_cosim_event(riscv_cosim_level_event(RiscvCosimEventNmi, rvfi_instr.nmi));
+        add_cosim_event(riscv_cosim_level_event(RiscvCosimEventNmiInt, rvfi_instr.nmi_int));
+        add_cosim_event(riscv_cosim_mip_event(rvfi_instr.pre_mip, rvfi_instr.pre_mip));
 
         continue;
       end
@@ -139,39 +157,33 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
         // Check if the top of the iside_error_queue relates to the current RVFI instruction. If so
         // notify the cosim environment of an instruction error.
         if (iside_error_queue.size() !=0 && iside_error_queue[0].order == rvfi_instr.order) begin
-          riscv_cosim_set_iside_error(cosim_handle, iside_error_queue[0].addr);
+          add_cosim_event(riscv_cosim_iside_error_event(iside_error_queue[0].addr));
           iside_error_queue.pop_front();
         end
       end
 
       // Note these must be called in this order to ensure debug vs nmi vs normal interrupt are
       // handled with the correct priority when they occur together.
-      riscv_cosim_set_debug_req(cosim_handle, rvfi_instr.debug_req);
-      riscv_cosim_set_nmi(cosim_handle, rvfi_instr.nmi);
-      riscv_cosim_set_nmi_int(cosim_handle, rvfi_instr.nmi_int);
-      riscv_cosim_set_mip(cosim_handle, rvfi_instr.pre_mip, rvfi_instr.post_mip);
-      riscv_cosim_set_mcycle(cosim_handle, rvfi_instr.mcycle);
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventDebugReq, rvfi_instr.debug_req));
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventNmi, rvfi_instr.nmi));
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventNmiInt, rvfi_instr.nmi_int));
+      add_cosim_event(riscv_cosim_mip_event(rvfi_instr.pre_mip, rvfi_instr.post_mip));
+      add_cosim_event(riscv_cosim_mcycle_event(rvfi_instr.mcycle));
 
       // Set performance counters through a pseudo-backdoor write
       for (int i=0; i < 10; i++) begin
-        riscv_cosim_set_csr(cosim_handle,
-                            ibex_pkg::CSR_MHPMCOUNTER3 + i, rvfi_instr.mhpmcounters[i]);
-        riscv_cosim_set_csr(cosim_handle,
-                            ibex_pkg::CSR_MHPMCOUNTER3H + i, rvfi_instr.mhpmcountersh[i]);
+        add_cosim_event(riscv_cosim_csr_event(ibex_pkg::CSR_MHPMCOUNTER3 + i,
+                                              rvfi_instr.mhpmcounters[i]));
+        add_cosim_event(riscv_cosim_csr_event(ibex_pkg::CSR_MHPMCOUNTER3H + i,
+                                              rvfi_instr.mhpmcountersh[i]));
       end
 
-      riscv_cosim_set_ic_scr_key_valid(cosim_handle, rvfi_instr.ic_scr_key_valid);
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventIcScrKeyValid,
+                                              rvfi_instr.ic_scr_key_valid));
 
-      if (!riscv_cosim_step(cosim_handle, rvfi_instr.rd_addr, rvfi_instr.rd_wdata, rvfi_instr.pc,
-                            rvfi_instr.trap, rvfi_instr.rf_wr_suppress)) begin
-        // cosim instruction step doesn't match rvfi captured instruction, report a fatal error
-        // with the details
-        if (cfg.relax_cosim_check) begin
-          `uvm_info(`gfn, get_cosim_error_str(), UVM_LOW)
-        end else begin
-          `uvm_fatal(`gfn, get_cosim_error_str())
-        end
-      end
+      add_cosim_event(riscv_cosim_step_event(rvfi_instr.rd_addr, rvfi_instr.rd_wdata,
+                                             rvfi_instr.pc, rvfi_instr.trap,
+                                             rvfi_instr.rf_wr_suppress));
     end
   endtask: run_cosim_rvfi
 
@@ -181,9 +193,9 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
     forever begin
       dmem_port.get(mem_op);
       // Notify the cosim of all dside accesses emitted by the RTL
-      riscv_cosim_notify_dside_access(cosim_handle, mem_op.read_write == WRITE, mem_op.addr,
+      add_cosim_event(riscv_cosim_dside_access_event(mem_op.read_write == WRITE, mem_op.addr,
         mem_op.data, mem_op.be, mem_op.error, mem_op.misaligned_first, mem_op.misaligned_second,
-        mem_op.misaligned_first_saw_error, mem_op.m_mode_access);
+        mem_op.misaligned_first_saw_error, mem_op.m_mode_access));
     end
   endtask: run_cosim_dmem
 
@@ -330,6 +342,46 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
     end
   endtask: run_cosim_prune_imem_errors
 
+  // Queue an event for the cosim, handing all queued events over once the batch is full.
+  function void add_cosim_event(bit [95:0] cosim_event);
+    cosim_events[num_cosim_events]      = cosim_event;
+    cosim_event_times[num_cosim_events] = $time;
+    num_cosim_events++;
+
+    if (num_cosim_events == cosim_events.size()) begin
+      flush_cosim_events();
+    end
+  endfunction : add_cosim_event
+
+  // Hand all queued events to the cosim. Anything that accesses cosim state directly (e.g.
+  // backdoor memory writes) must call this first so it sees the effects of earlier events.
+  function void flush_cosim_events();
+    int start_idx = 0;
+
+    while (start_idx < num_cosim_events) begin
+      int mismatch_idx = riscv_cosim_step_batch(cosim_handle, cosim_events, start_idx,
+                                                num_cosim_events);
+
+      if (mismatch_idx < 0) begin
+        break;
+      end
+
+      // cosim instruction step doesn't match rvfi captured instruction, report a fatal error
+      // with the details. When the check is relaxed carry on from the following event.
+      if (cfg.relax_cosim_check) begin
+        `uvm_info(`gfn, $sformatf("%s(seen at time %0t)", get_cosim_error_str(),
+                                  cosim_event_times[mismatch_idx]), UVM_LOW)
+      end else begin
+        `uvm_fatal(`gfn, $sformatf("%s(seen at time %0t)", get_cosim_error_str(),
+                                   cosim_event_times[mismatch_idx]))
+      end
+
+      start_idx = mismatch_idx + 1;
+    end
+
+    num_cosim_events = 0;
+  endfunction : flush_cosim_events
+
   function string get_cosim_error_str();
       string error = "Cosim mismatch ";
       for (int i = 0; i < riscv_cosim_get_num_errors(cosim_handle); ++i) begin
@@ -343,8 +395,22 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
   function void final_phase(uvm_phase phase);
     super.final_phase(phase);
 
+    flush_cosim_events();
+
+    // With an asynchronous cosim mismatches in the last few instructions may not have been
+    // reported yet
+    if (spike_cosim_take_async_failures(cosim_handle) != 0) begin
+      if (cfg.relax_cosim_check) begin
+        `uvm_info(`gfn, get_cosim_error_str(), UVM_LOW)
+      end else begin
+        `uvm_error(`gfn, get_cosim_error_str())
+      end
+    end
+
     `uvm_info(`gfn, $sformatf("Co-simulation matched %d instructions",
                                 riscv_cosim_get_insn_cnt(cosim_handle)), UVM_LOW)
+    `uvm_info(`gfn, $sformatf("Co-simulation memory touched %0d pages",
+                                spike_cosim_get_mem_pages_touched(cosim_handle)), UVM_LOW)
 
     cleanup_cosim();
   endfunction : final_phase
@@ -352,10 +418,12 @@ class ibex_cosim_scoreboard extends uvm_scoreboard;
   // If the UVM_EXIT action is triggered (such as by reaching max_quit_count), this callback is run.
   // This ensures proper cleanup, such as committing the logfile to disk.
   function void pre_abort();
+    // Don't flush queued events here, a mismatch would report another fatal error
     cleanup_cosim();
   endfunction
 
   task handle_reset();
+    flush_cosim_events();
     init_cosim();
   endtask
 endclass : ibex_cosim_scoreboard
@@ -6,9 +6,32 @@
 
 #include <cassert>
 
+#include "async_cosim.h"
 #include "cosim.h"
+#include "cosim_trace.h"
+#include "multi_hart_cosim.h"
+#include "recording_cosim.h"
 #include "spike_cosim.h"
 
+// Return the SpikeCosim behind a handle, which may have been wrapped by
+// `spike_cosim_make_async` and/or be recording a trace
+static SpikeCosim *get_spike_cosim(void *cosim_handle) {
+  auto cosim = static_cast<Cosim *>(cosim_handle);
+
+  if (auto async_cosim = dynamic_cast<AsyncCosim *>(cosim)) {
+    cosim = async_cosim->get_wrapped();
+  }
+
+  if (auto recording_cosim = dynamic_cast<RecordingCosim *>(cosim)) {
+    cosim = recording_cosim->get_wrapped();
+  }
+
+  auto spike_cosim = dynamic_cast<SpikeCosim *>(cosim);
+  assert(spike_cosim);
+
+  return spike_cosim;
+}
+
 extern "C" {
 void *spike_cosim_init(const char *isa_string, svBitVecVal *start_pc,
                        svBitVecVal *start_mtvec, const char *log_file_path_cstr,
@@ -16,7 +39,7 @@ void *spike_cosim_init(const char *isa_string, svBitVecVal *start_pc,
                        svBitVecVal *pmp_granularity,
                        svBitVecVal *mhpm_counter_num, svBit secure_ibex,
                        svBit icache, svBitVecVal *dm_start_addr,
-                       svBitVecVal *dm_end_addr) {
+                       svBitVecVal *dm_end_addr, const char *trace_file) {
   assert(isa_string);
 
   std::string log_file_path;
@@ -25,14 +48,104 @@ void *spike_cosim_init(const char *isa_string, svBitVecVal *start_pc,
     log_file_path = log_file_path_cstr;
   }
 
-  SpikeCosim *cosim = new SpikeCosim(
-      isa_string, start_pc[0], start_mtvec[0], log_file_path, secure_ibex,
-      icache, pmp_num_regions[0], pmp_granularity[0], mhpm_counter_num[0],
-      dm_start_addr[0], dm_end_addr[0]);
+  CosimTraceConfig config;
+  config.isa_string = isa_string;
+  config.start_pc = start_pc[0];
+  config.start_mtvec = start_mtvec[0];
+  config.secure_ibex = secure_ibex;
+  config.icache_en = icache;
+  config.pmp_num_regions = pmp_num_regions[0];
+  config.pmp_granularity = pmp_granularity[0];
+  config.mhpm_counter_num = mhpm_counter_num[0];
+  config.dm_start_addr = dm_start_addr[0];
+  config.dm_end_addr = dm_end_addr[0];
+
+  Cosim *cosim = new SpikeCosim(
+      config.isa_string, config.start_pc, config.start_mtvec, log_file_path,
+      config.secure_ibex, config.icache_en, config.pmp_num_regions,
+      config.pmp_granularity, config.mhpm_counter_num, config.dm_start_addr,
+      config.dm_end_addr);
+
+  if (trace_file && trace_file[0] != '\0') {
+    auto recording_cosim = new RecordingCosim(std::unique_ptr<Cosim>(cosim),
+                                              trace_file, config);
+    if (!recording_cosim->is_recording()) {
+      delete recording_cosim;
+      return nullptr;
+    }
+
+    cosim = recording_cosim;
+  }
+
   // Add a memory device that covers the entire address space.
   // This will only be sparsely populated.
   cosim->add_memory(0x00000000, 0xFFFF0000);
-  return static_cast<Cosim *>(cosim);
+  return cosim;
+}
+
+void spike_cosim_set_fast_fetch(void *cosim_handle, svBit enable) {
+  get_spike_cosim(cosim_handle)->set_fast_fetch(enable);
+}
+
+int spike_cosim_get_mem_pages_touched(void *cosim_handle) {
+  return get_spike_cosim(cosim_handle)->get_mem_pages_touched();
+}
+
+void *spike_cosim_make_async(void *cosim_handle) {
+  std::unique_ptr<Cosim> cosim(static_cast<Cosim *>(cosim_handle));
+
+  return static_cast<Cosim *>(new AsyncCosim(std::move(cosim)));
+}
+
+int spike_cosim_take_async_failures(void *cosim_handle) {
+  auto cosim = static_cast<Cosim *>(cosim_handle);
+
+  if (auto async_cosim = dynamic_cast<AsyncCosim *>(cosim)) {
+    return async_cosim->take_unreported_failed_steps();
+  }
+
+  return 0;
+}
+
+void *spike_cosim_multi_init(
+    const char *isa_string, svBitVecVal *start_pc, svBitVecVal *start_mtvec,
+    const char *log_file_path_cstr, svBitVecVal *pmp_num_regions,
+    svBitVecVal *pmp_granularity, svBitVecVal *mhpm_counter_num,
+    svBit secure_ibex, svBit icache, svBitVecVal *dm_start_addr,
+    svBitVecVal *dm_end_addr, int num_harts) {
+  assert(isa_string);
+
+  if (num_harts <= 0) {
+    return nullptr;
+  }
+
+  std::string log_file_path;
+
+  if (log_file_path_cstr) {
+    log_file_path = log_file_path_cstr;
+  }
+
+  auto multi_cosim = new MultiHartCosim(
+      num_harts, isa_string, start_pc[0], start_mtvec[0], log_file_path,
+      secure_ibex, icache, pmp_num_regions[0], pmp_granularity[0],
+      mhpm_counter_num[0], dm_start_addr[0], dm_end_addr[0]);
+
+  // Add a memory device that covers the entire address space, shared by all
+  // harts. This will only be sparsely populated.
+  multi_cosim->add_memory(0x00000000, 0xFFFF0000);
+  return multi_cosim;
+}
+
+void *spike_cosim_multi_get_hart(void *multi_cosim_handle, int hart_id) {
+  auto multi_cosim = static_cast<MultiHartCosim *>(multi_cosim_handle);
+
+  return static_cast<Cosim *>(multi_cosim->get_hart(hart_id));
+}
+
+void spike_cosim_multi_release(void *multi_cosim_handle) {
+  auto multi_cosim = static_cast<MultiHartCosim *>(multi_cosim_handle);
+
+  delete multi_cosim;
 }
 
 void spike_cosim_release(void *cosim_handle) {
@@ -3,5 +3,11 @@
 // SPDX-License-Identifier: Apache-2.0
 
 ${PRJ_DIR}/dv/uvm/core_ibex/common/ibex_cosim_agent/spike_cosim_dpi.cc
+${PRJ_DIR}/dv/cosim/cosim.cc
 ${PRJ_DIR}/dv/cosim/cosim_dpi.cc
 ${PRJ_DIR}/dv/cosim/spike_cosim.cc
+${PRJ_DIR}/dv/cosim/sparse_mem.cc
+${PRJ_DIR}/dv/cosim/async_cosim.cc
+${PRJ_DIR}/dv/cosim/cosim_trace.cc
+${PRJ_DIR}/dv/cosim/recording_cosim.cc
+${PRJ_DIR}/dv/cosim/multi_hart_cosim.cc
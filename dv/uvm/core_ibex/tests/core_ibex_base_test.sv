@@ -145,6 +145,10 @@ class core_ibex_base_test extends uvm_test;
     cosim_cfg.probe_imem_for_errs = 1'b0;
     void'($value$plusargs("cosim_log_file=%0s", cosim_log_file));
     cosim_cfg.log_file = cosim_log_file;
+    void'($value$plusargs("cosim_batch_events=%0d", cosim_cfg.cosim_batch_events));
+    void'($value$plusargs("cosim_fast_fetch=%b", cosim_cfg.fast_fetch));
+    void'($value$plusargs("cosim_async=%b", cosim_cfg.async_cosim));
+    void'($value$plusargs("cosim_trace_file=%0s", cosim_cfg.trace_file));
 
     if (!uvm_config_db#(bit [31:0])::get(null, "", "PMPNumRegions", pmp_num_regions)) begin
       pmp_num_regions = '0;
@@ -0,0 +1,358 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ibex_arch_state.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <svdpi.h>
+
+#include "sv_scoped.h"
+
+// DPI backdoors, see rtl/ibex_register_file_ff.sv and rtl/ibex_cs_registers.sv
+extern "C" {
+extern int ibex_rf_backdoor_read(unsigned int index, unsigned int *val);
+extern int ibex_rf_backdoor_write(unsigned int index, unsigned int val);
+extern int ibex_csr_backdoor_read(unsigned int csr_num, unsigned int *val);
+extern int ibex_csr_backdoor_write(unsigned int csr_num, unsigned int val);
+extern unsigned int ibex_priv_backdoor_read();
+extern int ibex_priv_backdoor_write(unsigned int priv_lvl);
+extern void ibex_pmp_backdoor_config(unsigned int *num_regions,
+                                     unsigned int *granularity);
+extern unsigned int ibex_csr_reg_backdoor_read();
+extern int ibex_csr_reg_backdoor_write(unsigned int val);
+extern void ibex_boot_pc_backdoor_write(svBit en, unsigned int pc);
+}
+
+static const int kCsrPmpCfg0 = 0x3a0;
+static const int kCsrPmpAddr0 = 0x3b0;
+static const int kCsrMseccfg = 0x747;
+
+const std::vector<int> ArchState::kCsrs = {
+    0x300,  // mstatus
+    0x304,  // mie
+    0x305,  // mtvec
+    0x320,  // mcountinhibit
+    0x340,  // mscratch
+    0x341,  // mepc
+    0x342,  // mcause
+    0x343,  // mtval
+    0x7b0,  // dcsr
+    0x7b1,  // dpc
+    0x7b2,  // dscratch0
+    0x7b3,  // dscratch1
+    0x7c0,  // cpuctrlsts
+    0xb00,  // mcycle
+    0xb02,  // minstret
+    0xb80,  // mcycleh
+    0xb82,  // minstreth
+};
+
+// ibex_top generates one of these depending on its RegFile parameter
+static const char *const kRegFileScopes[] = {
+    ".gen_regfile_ff.register_file_i",
+    ".gen_regfile_fpga.register_file_i",
+    ".gen_regfile_latch.register_file_i",
+};
+
+static std::string RegFileScope(const std::string &top_scope) {
+  for (const char *rf_scope : kRegFileScopes) {
+    std::string scope = top_scope + rf_scope;
+    if (svGetScopeFromName(scope.c_str())) {
+      return scope;
+    }
+  }
+
+  throw std::runtime_error("No register file found in " + top_scope);
+}
+
+static std::string CsrScope(const std::string &top_scope) {
+  return top_scope + ".u_ibex_core.cs_registers_i";
+}
+
+// The PMP CSRs are held in ibex_csr instances in a generate block of
+// ibex_cs_registers. `reg_name` is one of "u_pmp_cfg_csr" or "u_pmp_addr_csr".
+static std::string PmpRegionScope(const std::string &top_scope,
+                                  const char *reg_name, unsigned int region) {
+  return CsrScope(top_scope) + ".g_pmp_registers.g_pmp_csrs[" +
+         std::to_string(region) + "]." + reg_name;
+}
+
+static std::string PmpMseccfgScope(const std::string &top_scope) {
+  return CsrScope(top_scope) + ".g_pmp_registers.u_pmp_mseccfg";
+}
+
+namespace {
+// PMP configuration of an Ibex instance, which determines the PMP CSRs that
+// exist and how their contents are stored
+struct PmpConfig {
+  unsigned int num_regions;
+  unsigned int granularity;
+
+  explicit PmpConfig(const std::string &top_scope) {
+    SVScoped scoped(CsrScope(top_scope));
+    ibex_pmp_backdoor_config(&num_regions, &granularity);
+  }
+
+  // pmpaddr bits below this aren't stored
+  unsigned int AddrShift() const {
+    return granularity ? granularity - 1 : 0;
+  }
+};
+}  // namespace
+
+static unsigned int RegBackdoorRead(const std::string &scope) {
+  SVScoped scoped(scope);
+  return ibex_csr_reg_backdoor_read();
+}
+
+static std::runtime_error CsrWriteError(int csr_num,
+                                        const std::string &scope) {
+  std::ostringstream oss;
+  oss << "Cannot write CSR 0x" << std::hex << csr_num << " in " << scope;
+  return std::runtime_error(oss.str());
+}
+
+static void RegBackdoorWrite(const std::string &scope, int csr_num,
+                             unsigned int val) {
+  SVScoped scoped(scope);
+  if (!ibex_csr_reg_backdoor_write(val)) {
+    throw CsrWriteError(csr_num, scope);
+  }
+}
+
+// A pmpNcfg field is stored as {lock, mode[1:0], exec, write, read}, the
+// architectural layout has two reserved bits below the lock bit
+static unsigned int PmpCfgToArch(unsigned int stored) {
+  return (((stored >> 5) & 0x1) << 7) | (stored & 0x1f);
+}
+
+static unsigned int PmpCfgFromArch(unsigned int val) {
+  return (((val >> 7) & 0x1) << 5) | (val & 0x1f);
+}
+
+static bool IsPmpCsr(int csr_num) {
+  return ((csr_num >= kCsrPmpCfg0) && (csr_num < kCsrPmpCfg0 + 4)) ||
+         ((csr_num >= kCsrPmpAddr0) && (csr_num < kCsrPmpAddr0 + 16)) ||
+         (csr_num == kCsrMseccfg);
+}
+
+std::vector<int> ArchState::PmpCsrs(unsigned int pmp_num_regions) {
+  std::vector<int> csrs;
+  if (pmp_num_regions == 0) {
+    return csrs;
+  }
+
+  for (unsigned int i = 0; i < (pmp_num_regions + 3) / 4; ++i) {
+    csrs.push_back(kCsrPmpCfg0 + i);
+  }
+  for (unsigned int i = 0; i < pmp_num_regions; ++i) {
+    csrs.push_back(kCsrPmpAddr0 + i);
+  }
+  csrs.push_back(kCsrMseccfg);
+
+  return csrs;
+}
+
+ArchState::ArchState() : num_gprs(32), gprs(), priv_lvl(3) {}
+
+void ArchState::ReadFromRtl(const std::string &top_scope) {
+  {
+    std::string rf_scope = RegFileScope(top_scope);
+    SVScoped scoped(rf_scope);
+
+    // The backdoor rejects registers beyond the last, which gives the number
+    // of registers
+    num_gprs = 1;
+    for (unsigned int i = 1; i < 32; ++i) {
+      unsigned int val;
+      if (!ibex_rf_backdoor_read(i, &val)) {
+        break;
+      }
+      gprs[i] = val;
+      num_gprs = i + 1;
+    }
+
+    if ((num_gprs != 16) && (num_gprs != 32)) {
+      throw std::runtime_error("Cannot read register file " + rf_scope);
+    }
+  }
+
+  SVScoped scoped(CsrScope(top_scope));
+
+  priv_lvl = ibex_priv_backdoor_read();
+
+  csrs.clear();
+  for (int csr_num : kCsrs) {
+    unsigned int val;
+    if (!ibex_csr_backdoor_read(csr_num, &val)) {
+      std::ostringstream oss;
+      oss << "Cannot read CSR 0x" << std::hex << csr_num << " in " << top_scope;
+      throw std::runtime_error(oss.str());
+    }
+    csrs[csr_num] = val;
+  }
+
+  ReadPmpFromRtl(top_scope);
+}
+
+void ArchState::ReadPmpFromRtl(const std::string &top_scope) {
+  PmpConfig pmp(top_scope);
+  if (pmp.num_regions == 0) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < pmp.num_regions; ++i) {
+    unsigned int cfg = PmpCfgToArch(
+        RegBackdoorRead(PmpRegionScope(top_scope, "u_pmp_cfg_csr", i)));
+    csrs[kCsrPmpCfg0 + i / 4] |= cfg << ((i % 4) * 8);
+
+    // As when reading the CSR, in OFF and TOR modes the lowest granularity
+    // bits read as zero, in NAPOT mode the bits below those read as one
+    uint32_t addr =
+        RegBackdoorRead(PmpRegionScope(top_scope, "u_pmp_addr_csr", i))
+        << pmp.AddrShift();
+    unsigned int mode = (cfg >> 3) & 0x3;
+    if (pmp.granularity && (mode <= 1)) {
+      addr &= ~((1u << pmp.granularity) - 1);
+    } else if ((pmp.granularity >= 2) && (mode == 3)) {
+      addr |= (1u << (pmp.granularity - 1)) - 1;
+    }
+    csrs[kCsrPmpAddr0 + i] = addr;
+  }
+
+  // mseccfg is stored as {rlb, mmwp, mml}, which matches its lowest bits
+  csrs[kCsrMseccfg] = RegBackdoorRead(PmpMseccfgScope(top_scope));
+}
+
+void ArchState::WriteToRtl(const std::string &top_scope) const {
+  {
+    std::string rf_scope = RegFileScope(top_scope);
+    SVScoped scoped(rf_scope);
+
+    for (unsigned int i = 1; i < num_gprs; ++i) {
+      if (!ibex_rf_backdoor_write(i, gprs[i])) {
+        throw std::runtime_error("Cannot write x" + std::to_string(i) +
+                                 " in " + rf_scope);
+      }
+    }
+  }
+
+  SVScoped scoped(CsrScope(top_scope));
+
+  if (!ibex_priv_backdoor_write(priv_lvl)) {
+    throw std::runtime_error("Cannot set privilege level " +
+                             std::to_string(priv_lvl) + " in " + top_scope);
+  }
+
+  std::map<int, uint32_t> pmp_csrs;
+  for (const auto &csr : csrs) {
+    if (IsPmpCsr(csr.first)) {
+      pmp_csrs.insert(csr);
+      continue;
+    }
+
+    if (!ibex_csr_backdoor_write(csr.first, csr.second)) {
+      throw CsrWriteError(csr.first, top_scope);
+    }
+  }
+
+  WritePmpToRtl(top_scope, pmp_csrs);
+}
+
+void ArchState::WritePmpToRtl(const std::string &top_scope,
+                              const std::map<int, uint32_t> &pmp_csrs) {
+  if (pmp_csrs.empty()) {
+    return;
+  }
+
+  PmpConfig pmp(top_scope);
+
+  for (const auto &csr : pmp_csrs) {
+    // The first region the CSR applies to, which must exist
+    unsigned int region = (csr.first == kCsrMseccfg) ? 0
+                          : (csr.first >= kCsrPmpAddr0)
+                              ? csr.first - kCsrPmpAddr0
+                              : (csr.first - kCsrPmpCfg0) * 4;
+    if (region >= pmp.num_regions) {
+      throw CsrWriteError(csr.first, top_scope);
+    }
+
+    if (csr.first == kCsrMseccfg) {
+      RegBackdoorWrite(PmpMseccfgScope(top_scope), csr.first,
+                       csr.second & 0x7);
+    } else if (csr.first >= kCsrPmpAddr0) {
+      RegBackdoorWrite(PmpRegionScope(top_scope, "u_pmp_addr_csr", region),
+                       csr.first, csr.second >> pmp.AddrShift());
+    } else {
+      // Fields for regions that aren't implemented read as zero so are
+      // ignored
+      for (unsigned int i = 0; i < 4 && region + i < pmp.num_regions; ++i) {
+        RegBackdoorWrite(
+            PmpRegionScope(top_scope, "u_pmp_cfg_csr", region + i), csr.first,
+            PmpCfgFromArch((csr.second >> (i * 8)) & 0xff));
+      }
+    }
+  }
+}
+
+void ArchState::SetBootPc(const std::string &top_scope, uint32_t pc) {
+  SVScoped scoped(top_scope + ".u_ibex_core.if_stage_i");
+  ibex_boot_pc_backdoor_write(1, pc);
+}
+
+void ArchState::Write(std::ostream &os) const {
+  os << "priv " << priv_lvl << "\n" << std::hex;
+
+  for (unsigned int i = 1; i < num_gprs; ++i) {
+    os << std::dec << "x" << i << std::hex << " 0x" << gprs[i] << "\n";
+  }
+
+  for (const auto &csr : csrs) {
+    os << "csr 0x" << csr.first << " 0x" << csr.second << "\n";
+  }
+
+  os << std::dec;
+}
+
+void ArchState::Read(std::istream &is) {
+  std::string line;
+  unsigned int line_num = 0;
+
+  while (std::getline(is, line)) {
+    ++line_num;
+
+    std::istringstream iss(line);
+    std::string name, arg, val;
+    if (!(iss >> name) || (name[0] == '#')) {
+      continue;
+    }
+
+    try {
+      if (name == "priv" && (iss >> val)) {
+        priv_lvl = std::stoul(val, nullptr, 0);
+        continue;
+      }
+
+      if (name == "csr" && (iss >> arg >> val)) {
+        csrs[std::stoul(arg, nullptr, 0)] = std::stoul(val, nullptr, 0);
+        continue;
+      }
+
+      if (name[0] == 'x' && (iss >> val)) {
+        unsigned long index = std::stoul(name.substr(1), nullptr, 10);
+        if (index > 0 && index < num_gprs) {
+          gprs[index] = std::stoul(val, nullptr, 0);
+          continue;
+        }
+      }
+    } catch (const std::logic_error &) {
+      // Parse errors from stoul, reported below
+    }
+
+    throw std::runtime_error("Cannot parse line " + std::to_string(line_num) +
+                             " of architectural state: " + line);
+  }
+}
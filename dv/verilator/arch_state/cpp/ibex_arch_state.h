@@ -0,0 +1,97 @@
+// Copyright lowRISC contributors.
+// Licensed under the Apache License, Version 2.0, see LICENSE for details.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef IBEX_ARCH_STATE_H_
+#define IBEX_ARCH_STATE_H_
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Architectural state of an Ibex core
+ *
+ * Holds the general purpose registers, the privilege level and the CSRs that
+ * can be accessed through the DPI backdoors in the Ibex register files,
+ * ibex_cs_registers and (for the PMP CSRs) ibex_csr (Verilator simulations
+ * only). It does for the core what DpiMemUtil does for memories, so state can
+ * be captured from or injected into a simulation without running code on the
+ * core to do it.
+ *
+ * The PC isn't included as it lives in the pipeline, which has no backdoor. To
+ * continue from a given PC, write the state just after reset and use
+ * SetBootPc() so the core starts fetching from there.
+ *
+ * SecureIbex configurations aren't supported: the lockstep shadow core runs a
+ * few cycles behind the main core so can't be written at the same time.
+ */
+class ArchState {
+ public:
+  // The CSRs read by ReadFromRtl(), other than the PMP CSRs
+  static const std::vector<int> kCsrs;
+
+  // The PMP CSRs of a core with the given number of PMP regions (pmpcfg,
+  // pmpaddr and mseccfg), which ReadFromRtl() also reads
+  static std::vector<int> PmpCsrs(unsigned int pmp_num_regions);
+
+  // Number of general purpose registers, 16 for RV32E and 32 otherwise.
+  // Register 0 is always 0.
+  unsigned int num_gprs;
+  uint32_t gprs[32];
+  uint32_t priv_lvl;
+  std::map<int, uint32_t> csrs;
+
+  ArchState();
+
+  /**
+   * Read the state of the ibex_top instance with the given (absolute) scope,
+   * e.g. "TOP.ibex_simple_system.u_top.u_ibex_top".
+   *
+   * Throws an exception if the backdoors aren't found.
+   */
+  void ReadFromRtl(const std::string &top_scope);
+
+  /**
+   * Write the state into the ibex_top instance with the given scope. This
+   * takes effect immediately, so should be done between clock edges.
+   *
+   * Most CSRs are legalised as a software write would be. PMP CSRs are written
+   * as given (other than reserved bits), so should hold values read from a
+   * core with the same PMP configuration.
+   *
+   * Throws an exception if the backdoors aren't found or reject a value.
+   */
+  void WriteToRtl(const std::string &top_scope) const;
+
+  /**
+   * Make the ibex_top instance with the given scope fetch its first
+   * instruction from `pc`, rather than the boot address, every time it comes
+   * out of reset. This can be done before reset is released.
+   *
+   * Throws an exception if the backdoor isn't found.
+   */
+  static void SetBootPc(const std::string &top_scope, uint32_t pc);
+
+  /**
+   * Write the state as text, one "<name> <value>" pair per line with CSRs
+   * named by number (e.g. "csr 0x300 0x1880").
+   */
+  void Write(std::ostream &os) const;
+
+  /**
+   * Read state written by Write(). Anything not given keeps its current value.
+   *
+   * Throws a std::runtime_error on a line that can't be parsed.
+   */
+  void Read(std::istream &is);
+
+ private:
+  void ReadPmpFromRtl(const std::string &top_scope);
+  static void WritePmpToRtl(const std::string &top_scope,
+                            const std::map<int, uint32_t> &pmp_csrs);
+};
+
+#endif  // IBEX_ARCH_STATE_H_
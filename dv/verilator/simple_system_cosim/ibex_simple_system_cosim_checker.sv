@@ -10,7 +10,12 @@ module ibex_simple_system_cosim_checker #(
   parameter int unsigned        PMPNumRegions  = 4,
   parameter int unsigned        MHPMCounterNum = 0,
   parameter int unsigned        DmBaseAddr     = 32'h1A110000,
-  parameter int unsigned        DmAddrMask     = 32'h00000FFF
+  parameter int unsigned        DmAddrMask     = 32'h00000FFF,
+  // Number of co-simulation events (retired instructions, interrupt changes, memory accesses
+  // etc) that are buffered before being handed to the co-simulator in a single DPI call. Each
+  // retired instruction produces 27 events plus one per memory access, so a mismatch is only seen
+  // up to around 300 instructions after it happens with the default.
+  parameter int unsigned        CosimEventBufferSize = 8192
 ) (
   input clk_i,
   input rst_ni,
@@ -30,11 +35,10 @@ module ibex_simple_system_cosim_checker #(
   import "DPI-C" function void create_cosim(bit secure_ibex, bit icache_en,
     bit [31:0] pmp_num_regions, bit [31:0] pmp_granularity, bit [31:0] mhpm_counter_num,
     bit [31:0] DmStartAddr, bit [31:0] DmEndAddr);
+  import "DPI-C" function void simple_system_cosim_mismatch();
 
   import ibex_pkg::*;
 
-  chandle cosim_handle;
-
   initial begin
     localparam int unsigned LocalPMPGranularity = PMPEnable ? PMPGranularity : 0;
     localparam int unsigned LocalPMPNumRegions  = PMPEnable ? PMPNumRegions  : 0;
@@ -43,39 +47,91 @@ module ibex_simple_system_cosim_checker #(
 
     create_cosim(SecureIbex, ICache, LocalPMPNumRegions, LocalPMPGranularity, MHPMCounterNum,
                  DmStartAddr, DmEndAddr);
-    cosim_handle = get_spike_cosim();
   end
 
+  bit [95:0] cosim_events      [CosimEventBufferSize];
+  time       cosim_event_times [CosimEventBufferSize];
+  int        num_cosim_events = 0;
+  // Set once a mismatch has been reported, nothing further is checked
+  bit        cosim_failed = 1'b0;
+
+  // Replay all buffered events against the co-simulator, stopping the simulation on a mismatch.
+  // The stop goes through the simulation control, which finishes the run as it would for any other
+  // failure (closing traces, keeping a --trace-last trace and writing statistics).
+  function automatic void flush_cosim_events();
+    int mismatch_idx;
+    chandle cosim_handle;
+
+    if (num_cosim_events == 0) begin
+      return;
+    end
+
+    // Fetch the handle on every flush rather than keeping it in a variable, a restored simulation
+    // checkpoint would otherwise leave behind the pointer from the process that saved it.
+    cosim_handle = get_spike_cosim();
+
+    mismatch_idx = riscv_cosim_step_batch(cosim_handle, cosim_events, 0, num_cosim_events);
+    num_cosim_events = 0;
+
+    if (mismatch_idx >= 0) begin
+      $display("FAILURE: Co-simulation mismatch at time %t", cosim_event_times[mismatch_idx]);
+      for (int i = 0;i < riscv_cosim_get_num_errors(cosim_handle); ++i) begin
+        $display(riscv_cosim_get_error(cosim_handle, i));
+      end
+      riscv_cosim_clear_errors(cosim_handle);
+
+      cosim_failed = 1'b1;
+      simple_system_cosim_mismatch();
+    end
+  endfunction
+
+  function automatic void add_cosim_event(bit [95:0] cosim_event);
+    if (cosim_failed) begin
+      return;
+    end
+
+    cosim_events[num_cosim_events]      = cosim_event;
+    cosim_event_times[num_cosim_events] = $time();
+    num_cosim_events++;
+
+    if (num_cosim_events == CosimEventBufferSize) begin
+      flush_cosim_events();
+    end
+  endfunction
+
   always @(posedge clk_i) begin
     if (u_top.rvfi_valid) begin
-      riscv_cosim_set_nmi(cosim_handle, u_top.rvfi_ext_nmi);
-      riscv_cosim_set_nmi_int(cosim_handle, u_top.rvfi_ext_nmi_int);
-      riscv_cosim_set_mip(cosim_handle, u_top.rvfi_ext_pre_mip, u_top.rvfi_ext_post_mip);
-      riscv_cosim_set_debug_req(cosim_handle, u_top.rvfi_ext_debug_req);
-      riscv_cosim_set_mcycle(cosim_handle, u_top.rvfi_ext_mcycle);
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventNmi, u_top.rvfi_ext_nmi));
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventNmiInt, u_top.rvfi_ext_nmi_int));
+      add_cosim_event(riscv_cosim_mip_event(u_top.rvfi_ext_pre_mip, u_top.rvfi_ext_post_mip));
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventDebugReq,
+                                              u_top.rvfi_ext_debug_req));
+      add_cosim_event(riscv_cosim_mcycle_event(u_top.rvfi_ext_mcycle));
       for (int i=0; i < 10; i++) begin
-        riscv_cosim_set_csr(cosim_handle, int'(CSR_MHPMCOUNTER3) + i,
-          u_top.rvfi_ext_mhpmcounters[i]);
-        riscv_cosim_set_csr(cosim_handle, int'(CSR_MHPMCOUNTER3H) + i,
-          u_top.rvfi_ext_mhpmcountersh[i]);
-      end
-      riscv_cosim_set_ic_scr_key_valid(cosim_handle, u_top.rvfi_ext_ic_scr_key_valid);
-
-      if (riscv_cosim_step(cosim_handle, u_top.rvfi_rd_addr, u_top.rvfi_rd_wdata,
-                           u_top.rvfi_pc_rdata, u_top.rvfi_trap,
-                           u_top.rvfi_ext_rf_wr_suppress) == 0)
-      begin
-        $display("FAILURE: Co-simulation mismatch at time %t", $time());
-        for (int i = 0;i < riscv_cosim_get_num_errors(cosim_handle); ++i) begin
-          $display(riscv_cosim_get_error(cosim_handle, i));
-        end
-        riscv_cosim_clear_errors(cosim_handle);
-
-        $fatal(1, "Co-simulation mismatch seen");
+        add_cosim_event(riscv_cosim_csr_event(int'(CSR_MHPMCOUNTER3) + i,
+          u_top.rvfi_ext_mhpmcounters[i]));
+        add_cosim_event(riscv_cosim_csr_event(int'(CSR_MHPMCOUNTER3H) + i,
+          u_top.rvfi_ext_mhpmcountersh[i]));
       end
+      add_cosim_event(riscv_cosim_level_event(RiscvCosimEventIcScrKeyValid,
+                                              u_top.rvfi_ext_ic_scr_key_valid));
+
+      add_cosim_event(riscv_cosim_step_event(u_top.rvfi_rd_addr, u_top.rvfi_rd_wdata,
+                                             u_top.rvfi_pc_rdata, u_top.rvfi_trap,
+                                             u_top.rvfi_ext_rf_wr_suppress));
     end
   end
 
+  // Called from C++ once the simulation has stopped (see SimpleSystemCosim::PostExec) to check any
+  // events still buffered, whichever way the simulation ended. A final block would be too late:
+  // those run as the simulation control is ending the run, after which it doesn't act on a
+  // mismatch.
+  export "DPI-C" function simple_system_cosim_flush;
+
+  function automatic void simple_system_cosim_flush();
+    flush_cosim_events();
+  endfunction
+
   logic outstanding_store;
   logic [31:0] outstanding_addr;
   logic [3:0] outstanding_be;
@@ -111,10 +167,10 @@ module ibex_simple_system_cosim_checker #(
       end
 
       if (host_dmem_rvalid) begin
-        riscv_cosim_notify_dside_access(cosim_handle, outstanding_store, outstanding_addr,
+        add_cosim_event(riscv_cosim_dside_access_event(outstanding_store, outstanding_addr,
           outstanding_store ? outstanding_store_data : host_dmem_rdata, outstanding_be,
           host_dmem_err, outstanding_misaligned_first, outstanding_misaligned_second,
-          outstanding_misaligned_first_saw_error, outstanding_m_mode_access);
+          outstanding_misaligned_first_saw_error, outstanding_m_mode_access));
       end
     end
   end
@@ -2,56 +2,416 @@
 // Licensed under the Apache License, Version 2.0, see LICENSE for details.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <getopt.h>
 #include <svdpi.h>
 #include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
 #include <memory>
+#include <string>
+#include <vector>
+#include "async_cosim.h"
 #include "cosim.h"
+#include "cosim_trace.h"
+#include "ibex_arch_state.h"
 #include "ibex_simple_system.h"
+#include "recording_cosim.h"
+#include "sim_ctrl_extension.h"
 #include "spike_cosim.h"
+#include "sv_scoped.h"
 #include "verilator_memutil.h"
+#include "verilator_sim_ctrl.h"
 
-class SimpleSystemCosim : public SimpleSystem {
+// Defined in ibex_simple_system_cosim_checker.sv
+extern "C" void simple_system_cosim_flush();
+
+// The co-simulation is also a simulation control extension so it can fail the
+// simulation before the simulation control acts on its result (e.g. keeping a
+// --trace-last trace) and so the co-simulator state is part of simulation
+// checkpoints.
+class SimpleSystemCosim : public SimpleSystem, public SimCtrlExtension {
  public:
-  std::unique_ptr<SpikeCosim> _cosim;
+  // Scope of the checker bound into the simple system
+  static constexpr const char *kCheckerScope =
+      "TOP.ibex_simple_system.u_ibex_simple_system_cosim_checker_bind";
+
+  // The co-simulator used for checking. This is `_spike_cosim`, possibly
+  // wrapped by a `RecordingCosim` and/or an `AsyncCosim`.
+  std::unique_ptr<Cosim> _cosim;
+  SpikeCosim *_spike_cosim;
 
   SimpleSystemCosim(const char *ram_hier_path, int ram_size_words)
-      : SimpleSystem(ram_hier_path, ram_size_words), _cosim(nullptr) {}
+      : SimpleSystem(ram_hier_path, ram_size_words),
+        _cosim(nullptr),
+        _spike_cosim(nullptr),
+        _fast_fetch(false),
+        _async(false),
+        _ff_insns(0),
+        _ff_use_pc(false),
+        _ff_pc(0),
+        _ff_handover_pending(false),
+        _ff_reset_seen(false),
+        _ff_handover_pc(0) {}
 
   ~SimpleSystemCosim() {}
 
   void CreateCosim(bool secure_ibex, bool icache_en, uint32_t pmp_num_regions,
                    uint32_t pmp_granularity, uint32_t mhpm_counter_num,
                    uint32_t DmStartAddr, uint32_t DmEndAddr) {
-    _cosim = std::make_unique<SpikeCosim>(
-        GetIsaString(), 0x100080, 0x100001, "simple_system_cosim.log",
-        secure_ibex, icache_en, pmp_num_regions, pmp_granularity,
-        mhpm_counter_num, DmStartAddr, DmEndAddr);
+    CosimTraceConfig config;
+    config.isa_string = GetIsaString();
+    config.start_pc = 0x100080;
+    config.start_mtvec = 0x100001;
+    config.secure_ibex = secure_ibex;
+    config.icache_en = icache_en;
+    config.pmp_num_regions = pmp_num_regions;
+    config.pmp_granularity = pmp_granularity;
+    config.mhpm_counter_num = mhpm_counter_num;
+    config.dm_start_addr = DmStartAddr;
+    config.dm_end_addr = DmEndAddr;
+
+    if (_ff_insns || _ff_use_pc) {
+      if (!FastForward(config)) {
+        VerilatorSimCtrl::GetInstance().RequestStop(false);
+      }
+    }
+
+    auto spike_cosim = std::make_unique<SpikeCosim>(
+        config.isa_string, config.start_pc, config.start_mtvec,
+        "simple_system_cosim.log", secure_ibex, icache_en, pmp_num_regions,
+        pmp_granularity, mhpm_counter_num, DmStartAddr, DmEndAddr);
+    _spike_cosim = spike_cosim.get();
+
+    _spike_cosim->set_fast_fetch(_fast_fetch);
+
+    _cosim = std::move(spike_cosim);
+
+    if (!_trace_file.empty()) {
+      auto recording_cosim = std::make_unique<RecordingCosim>(
+          std::move(_cosim), _trace_file, config);
+      if (!recording_cosim->is_recording()) {
+        std::cerr << "WARNING: Could not create co-simulation trace "
+                  << _trace_file << "\n";
+      }
+
+      _cosim = std::move(recording_cosim);
+    }
+
+    if (_async) {
+      _cosim = std::make_unique<AsyncCosim>(std::move(_cosim));
+    }
 
     // Add a memory device that covers the entire address space.
     // This will only be sparsely populated.
     _cosim->add_memory(0x00000000, 0xFFFF0000);
 
-    CopyMemAreaToCosim(&_ram, 0x100000);
+    if (_ff_cosim_state) {
+      // Continue from where fast-forward got to, memory included
+      if (!_cosim->restore_state(*_ff_cosim_state)) {
+        std::cerr << "ERROR: Could not set up the co-simulator to continue "
+                     "from fast-forward"
+                  << std::endl;
+        VerilatorSimCtrl::GetInstance().RequestStop(false);
+      }
+      _ff_cosim_state.reset();
+    } else {
+      CopyMemAreaToCosim(&_ram, 0x100000);
+    }
   }
 
  protected:
+  bool _fast_fetch;
+  bool _async;
+  std::string _trace_file;
+  // Fast-forward the program in the ISS by this many instructions (0 for no
+  // limit) and/or to this PC before simulating the RTL
+  uint64_t _ff_insns;
+  bool _ff_use_pc;
+  uint32_t _ff_pc;
+  // State reached by fast-forward, for the co-simulator and (once the core is
+  // out of reset) the RTL to continue from
+  std::unique_ptr<CosimState> _ff_cosim_state;
+  ArchState _ff_arch_state;
+  bool _ff_handover_pending;
+  bool _ff_reset_seen;
+  uint32_t _ff_handover_pc;
+
+  // Fast-forward through the start of the program in the ISS. The RAM it
+  // leaves is written back to the RTL memory straight away. The co-simulator
+  // created after this restores the ISS state, and the registers, CSRs and PC
+  // are written into the RTL through the ArchState backdoors when reset is
+  // released (see `OnClock`), so nothing is added to the program.
+  bool FastForward(const CosimTraceConfig &config) {
+    if (config.secure_ibex) {
+      // The backdoors can't write shadow CSRs or the lockstep core
+      std::cerr << "ERROR: Fast-forward is not supported with SecureIbex"
+                << std::endl;
+      return false;
+    }
+
+    SpikeCosim iss(config.isa_string, config.start_pc, config.start_mtvec, "",
+                   config.secure_ibex, config.icache_en,
+                   config.pmp_num_regions, config.pmp_granularity,
+                   config.mhpm_counter_num, config.dm_start_addr,
+                   config.dm_end_addr);
+    iss.add_memory(0x00000000, 0xFFFF0000);
+
+    std::vector<uint8_t> mem_data = _ram.Read(0, _ram.GetSizeWords());
+    iss.backdoor_write_mem(kRAM_BaseAddr, mem_data.size(), &mem_data[0]);
+
+    uint64_t max_insns =
+        _ff_insns ? _ff_insns : std::numeric_limits<uint64_t>::max();
+    uint64_t retired = iss.run_free(max_insns, _ff_use_pc, _ff_pc);
+    uint32_t pc = iss.get_pc();
+
+    std::cout << "Fast-forwarded " << retired << " instructions to PC 0x"
+              << std::hex << pc << std::dec << std::endl;
+
+    if ((retired != _ff_insns) && !(_ff_use_pc && (pc == _ff_pc))) {
+      std::cerr << "ERROR: Fast-forward stopped early, the program may be "
+                   "waiting for an interrupt"
+                << std::endl;
+      return false;
+    }
+
+    if (!iss.in_machine_mode()) {
+      std::cerr << "ERROR: Fast-forward must stop in machine mode"
+                << std::endl;
+      return false;
+    }
+
+    _ff_arch_state = ArchState();
+    _ff_arch_state.num_gprs =
+        (config.isa_string.rfind("rv32e", 0) == 0) ? 16 : 32;
+    for (unsigned int i = 1; i < _ff_arch_state.num_gprs; ++i) {
+      _ff_arch_state.gprs[i] = iss.get_gpr(i);
+    }
+
+    // The ISS leaves out CSRs the configuration doesn't have, PMP CSRs only
+    // exist for the configured regions
+    std::vector<int> csrs = ArchState::kCsrs;
+    std::vector<int> pmp_csrs = ArchState::PmpCsrs(config.pmp_num_regions);
+    csrs.insert(csrs.end(), pmp_csrs.begin(), pmp_csrs.end());
+    for (int csr_num : csrs) {
+      uint32_t val;
+      if (iss.get_csr(csr_num, val)) {
+        _ff_arch_state.csrs[csr_num] = val;
+      }
+    }
+
+    _ff_cosim_state = iss.save_state();
+    _ff_handover_pc = pc;
+    _ff_handover_pending = true;
+
+    iss.backdoor_read_mem(kRAM_BaseAddr, mem_data.size(), &mem_data[0]);
+    _ram.Write(0, mem_data);
+
+    return true;
+  }
+
   void CopyMemAreaToCosim(MemArea *area, uint32_t base_addr) {
     auto mem_data = area->Read(0, area->GetSizeWords());
     _cosim->backdoor_write_mem(base_addr, area->GetSizeBytes(), &mem_data[0]);
   }
 
   virtual int Setup(int argc, char **argv, bool &exit_app) override {
+    if (!ParseCosimArgs(argc, argv)) {
+      exit_app = true;
+      return 1;
+    }
+
+    VerilatorSimCtrl::GetInstance().RegisterExtension(this);
+
     int ret_code = SimpleSystem::Setup(argc, argv, exit_app);
     if (exit_app) {
       return ret_code;
     }
 
+    // The co-simulator is set up once from the initial blocks of the design so
+    // can't follow the system through the resets between programs
+    if (!_batch_elfs.empty()) {
+      std::cerr << "ERROR: --batch is not supported with co-simulation"
+                << std::endl;
+      exit_app = true;
+      return 1;
+    }
+
+    // A trace replays from reset, it can't capture the state fast-forward
+    // hands over
+    if ((_ff_insns || _ff_use_pc) && !_trace_file.empty()) {
+      std::cerr << "ERROR: --cosim-trace can't be combined with fast-forward"
+                << std::endl;
+      exit_app = true;
+      return 1;
+    }
+
     return 0;
   }
 
+  bool ParseCosimArgs(int argc, char **argv) {
+    const struct option long_options[] = {
+        {"cosim-fast-fetch", no_argument, nullptr, 'F'},
+        {"cosim-async", no_argument, nullptr, 'A'},
+        {"cosim-trace", required_argument, nullptr, 'T'},
+        {"fast-forward-insns", required_argument, nullptr, 'I'},
+        {"fast-forward-pc", required_argument, nullptr, 'P'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, no_argument, nullptr, 0}};
+
+    optind = 1;
+    while (1) {
+      int c = getopt_long(argc, argv, "-:h", long_options, nullptr);
+      if (c == -1) {
+        break;
+      }
+
+      // Disable error reporting by getopt
+      opterr = 0;
+
+      switch (c) {
+        case 'F':
+          _fast_fetch = true;
+          break;
+        case 'A':
+          _async = true;
+          break;
+        case 'T':
+          _trace_file = optarg;
+          break;
+        case 'I':
+          _ff_insns = strtoull(optarg, nullptr, 0);
+          break;
+        case 'P':
+          _ff_use_pc = true;
+          _ff_pc = strtoul(optarg, nullptr, 0);
+          break;
+        case 'h':
+          PrintCosimHelp();
+          break;
+        case '?':
+        default:;
+          // Ignore unrecognized options since they might be consumed by
+          // other utils
+      }
+    }
+
+    // Reset the command parsing index so the simulation control and memory
+    // utilities see all arguments
+    optind = 1;
+
+    return true;
+  }
+
+  void PrintCosimHelp() const {
+    std::cout
+        << "Co-simulation arguments:\n\n"
+           "--cosim-fast-fetch\n"
+           "  Serve instruction fetches in spike directly from host\n"
+           "  memory. Data accesses are still checked against the DUT.\n\n"
+           "--cosim-async\n"
+           "  Run the co-simulator on a separate thread. Mismatches are\n"
+           "  reported a short time after the failing instruction retires.\n\n"
+           "--cosim-trace=<file>\n"
+           "  Record everything passed to the co-simulator in <file> so\n"
+           "  checking can be re-run offline with cosim_replay.\n\n"
+           "--fast-forward-insns=<count>\n"
+           "  Run the first <count> instructions of the program in the\n"
+           "  co-simulator only, then continue in the RTL\n\n"
+           "--fast-forward-pc=<addr>\n"
+           "  Run the program in the co-simulator only until it reaches\n"
+           "  <addr>, then continue in the RTL\n\n";
+  }
+
+  // Declared in SimCtrlExtension
+  bool NeedsOnClock() const override { return _ff_handover_pending; }
+
+  // Hand the state reached by fast-forward over to the RTL once reset has been
+  // released. This is before the clock edge the core leaves reset on, so
+  // before it fetches anything.
+  void OnClock(unsigned long sim_time) override {
+    if (!_ff_handover_pending) {
+      return;
+    }
+
+    if (!_top.IO_RST_N) {
+      _ff_reset_seen = true;
+      return;
+    }
+
+    if (!_ff_reset_seen) {
+      return;
+    }
+
+    _ff_handover_pending = false;
+
+    try {
+      _ff_arch_state.WriteToRtl(kIbexTopScope);
+      ArchState::SetBootPc(kIbexTopScope, _ff_handover_pc);
+    } catch (const std::exception &err) {
+      std::cerr << "ERROR: Handing fast-forward state to the RTL: "
+                << err.what() << std::endl;
+      VerilatorSimCtrl::GetInstance().RequestStop(false);
+    }
+  }
+
+  void PostExec() override {
+    if (!_cosim) {
+      return;
+    }
+
+    // Check the events the checker still has buffered, a mismatch among them
+    // fails the simulation before its result is acted on
+    {
+      SVScoped scoped(kCheckerScope);
+      simple_system_cosim_flush();
+    }
+
+    if (!_async) {
+      return;
+    }
+
+    auto async_cosim = static_cast<AsyncCosim *>(_cosim.get());
+    if (async_cosim->take_unreported_failed_steps() != 0) {
+      std::cout << "FAILURE: Co-simulation mismatch seen at end of "
+                   "simulation\n";
+      for (auto &error : _cosim->get_errors()) {
+        std::cout << error << "\n";
+      }
+
+      VerilatorSimCtrl::GetInstance().RequestStop(false);
+    }
+  }
+
+  bool SaveCheckpoint(std::ostream &os) override {
+    assert(_cosim);
+
+    std::unique_ptr<CosimState> state = _cosim->save_state();
+    return state && _cosim->write_state(*state, os);
+  }
+
+  bool RestoreCheckpoint(std::istream &is) override {
+    assert(_cosim);
+
+    // The checkpoint holds the RTL state, so any fast-forward handover still
+    // to come would overwrite it
+    _ff_handover_pending = false;
+
+    std::unique_ptr<CosimState> state = _cosim->read_state(is);
+    return state && _cosim->restore_state(*state);
+  }
+
   virtual bool Finish() {
     std::cout << "Co-simulation matched " << _cosim->get_insn_cnt()
               << " instructions\n";
+    // `get_insn_cnt` waits for any asynchronous checking to complete so
+    // `_spike_cosim` can be accessed directly after it
+    std::cout << "Co-simulation memory touched "
+              << _spike_cosim->get_mem_pages_touched() << " pages ("
+              << (_spike_cosim->get_mem_pages_touched() *
+                  SparseMem::kPageSize) /
+                     1024
+              << " KiB)\n";
 
     return SimpleSystem::Finish();
   }
@@ -66,7 +426,13 @@ void *get_spike_cosim() {
   assert(simple_system_cosim);
   assert(simple_system_cosim->_cosim);
 
-  return static_cast<Cosim *>(simple_system_cosim->_cosim.get());
+  return simple_system_cosim->_cosim.get();
+}
+
+// Called by the checker on a co-simulation mismatch. Stopping through the
+// simulation control, rather than with $fatal, lets the run end as normal.
+void simple_system_cosim_mismatch() {
+  VerilatorSimCtrl::GetInstance().RequestStop(false);
 }
 
 void create_cosim(svBit secure_ibex, svBit icache_en,
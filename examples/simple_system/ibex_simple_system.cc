@@ -2,19 +2,34 @@
 // Licensed under the Apache License, Version 2.0, see LICENSE for details.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <getopt.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <string>
 
 #include "Vibex_simple_system__Syms.h"
+#include "ibex_arch_state.h"
 #include "ibex_pcounts.h"
 #include "ibex_simple_system.h"
 #include "verilated_toplevel.h"
 #include "verilator_memutil.h"
 #include "verilator_sim_ctrl.h"
 
+// Exported from ibex_simple_system.sv
+extern "C" unsigned long long mhpmcounter_get(int index);
+
 SimpleSystem::SimpleSystem(const char *ram_hier_path, int ram_size_words)
-    : _ram(ram_hier_path, ram_size_words, 4) {}
+    : _ram(ram_hier_path, ram_size_words, 4),
+      _num_seeds(0),
+      _first_seed(1),
+      _seed_addr(0),
+      _seed_jobs(0) {}
 
 int SimpleSystem::Main(int argc, char **argv) {
   bool exit_app;
@@ -24,6 +39,14 @@ int SimpleSystem::Main(int argc, char **argv) {
     return ret_code;
   }
 
+  if (!_batch_elfs.empty()) {
+    return RunBatch() ? 0 : 1;
+  }
+
+  if (_num_seeds) {
+    return RunSeeds() ? 0 : 1;
+  }
+
   Run();
 
   if (!Finish()) {
@@ -71,13 +94,308 @@ int SimpleSystem::Setup(int argc, char **argv, bool &exit_app) {
   simctrl.SetTop(&_top, &_top.IO_CLK, &_top.IO_RST_N,
                  VerilatorSimCtrlFlags::ResetPolarityNegative);
 
+  // Report instructions retired from minstret (mhpmcounter index 2). Exported
+  // DPI functions need their scope to be set when called from C++.
+  simctrl.SetInstructionCounter([]() -> unsigned long {
+    svSetScope(svGetScopeFromName("TOP.ibex_simple_system"));
+    return mhpmcounter_get(2);
+  });
+
   _memutil.RegisterMemoryArea("ram", kRAM_BaseAddr, &_ram);
   simctrl.RegisterExtension(&_memutil);
 
   exit_app = false;
+  if (!ParseSimpleSystemArgs(argc, argv, exit_app)) {
+    return 1;
+  }
+
   return simctrl.ParseCommandArgs(argc, argv, exit_app);
 }
 
+// Parse an unsigned number command line argument, accepting any base strtoul
+// does
+static bool ParseNumberArg(const char *arg_name, const char *arg_text,
+                           unsigned long &value) {
+  char *txt_end;
+  errno = 0;
+  value = strtoul(arg_text, &txt_end, 0);
+  if ((arg_text[0] < '0') || (arg_text[0] > '9') || *txt_end || errno) {
+    std::cerr << "ERROR: Bad " << arg_name << " argument: `" << arg_text
+              << "'" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool SimpleSystem::ParseSimpleSystemArgs(int argc, char **argv,
+                                         bool &exit_app) {
+  const struct option long_options[] = {
+      {"batch", required_argument, nullptr, 'B'},
+      {"seeds", required_argument, nullptr, 'N'},
+      {"first-seed", required_argument, nullptr, 'S'},
+      {"seed-addr", required_argument, nullptr, 'A'},
+      {"seed-jobs", required_argument, nullptr, 'J'},
+      {"arch-state-dump", required_argument, nullptr, 'D'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, no_argument, nullptr, 0}};
+
+  optind = 1;
+  while (1) {
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "-:h", long_options, &option_index);
+    if (c == -1) {
+      break;
+    }
+
+    // Disable error reporting by getopt
+    opterr = 0;
+
+    unsigned long value;
+    switch (c) {
+      case 'B':
+        if (!ReadBatchFile(optarg)) {
+          exit_app = true;
+          return false;
+        }
+        break;
+      case 'N':
+      case 'S':
+      case 'A':
+      case 'J':
+        if (!ParseNumberArg(long_options[option_index].name, optarg,
+                            value)) {
+          exit_app = true;
+          return false;
+        }
+        if (c == 'N') {
+          _num_seeds = value;
+        } else if (c == 'S') {
+          _first_seed = value;
+        } else if (c == 'A') {
+          _seed_addr = value;
+        } else {
+          _seed_jobs = value;
+        }
+        break;
+      case 'D':
+        _arch_state_file = optarg;
+        break;
+      case 'h':
+        std::cout << "Simple system arguments:\n\n"
+                     "--batch=FILE\n"
+                     "  Run each ELF file listed in FILE (one per line) in\n"
+                     "  turn, resetting the system in between. The result of\n"
+                     "  each is written to ibex_simple_system_batch.csv.\n\n"
+                     "--seeds=N\n"
+                     "  Run the loaded program with N seeds in parallel\n"
+                     "  processes, each in its own seed_<seed> directory\n\n"
+                     "--first-seed=N\n"
+                     "  First seed to run with --seeds (default 1)\n\n"
+                     "--seed-addr=ADDR\n"
+                     "  RAM address of the 32-bit word the seed is written to\n"
+                     "\n"
+                     "--seed-jobs=N\n"
+                     "  Maximum number of seeds to run at once (default: the\n"
+                     "  number of CPUs)\n\n"
+                     "--arch-state-dump=FILE\n"
+                     "  Write the architectural state of the core (registers\n"
+                     "  and key CSRs) to FILE at the end of the simulation\n\n";
+        break;
+      case '?':
+      default:;
+        // Ignore unrecognized options since they might be consumed by
+        // other utils
+    }
+  }
+
+  // Reset the command parsing index so the simulation control and memory
+  // utilities see all arguments
+  optind = 1;
+
+  if (_num_seeds) {
+    if (!_batch_elfs.empty()) {
+      std::cerr << "ERROR: --seeds can't be used with --batch" << std::endl;
+      exit_app = true;
+      return false;
+    }
+
+    if ((_seed_addr < kRAM_BaseAddr) ||
+        (_seed_addr > kRAM_BaseAddr + kRAM_SizeBytes - 4) ||
+        (_seed_addr % 4)) {
+      std::cerr << "ERROR: --seeds needs --seed-addr to give a word aligned "
+                   "RAM address"
+                << std::endl;
+      exit_app = true;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool SimpleSystem::ReadBatchFile(const std::string &batch_file) {
+  std::ifstream batch(batch_file);
+  if (!batch) {
+    std::cerr << "ERROR: Could not open batch file " << batch_file
+              << std::endl;
+    return false;
+  }
+
+  // One ELF file per line, skipping blank lines and # comments
+  std::string line;
+  while (std::getline(batch, line)) {
+    size_t start = line.find_first_not_of(" \t");
+    if ((start == std::string::npos) || (line[start] == '#')) {
+      continue;
+    }
+
+    size_t end = line.find_last_not_of(" \t\r");
+    _batch_elfs.push_back(line.substr(start, end - start + 1));
+  }
+
+  if (_batch_elfs.empty()) {
+    std::cerr << "ERROR: No ELF files listed in batch file " << batch_file
+              << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool SimpleSystem::RunBatch() {
+  VerilatorSimCtrl &simctrl = VerilatorSimCtrl::GetInstance();
+
+  std::cout << "Simulation of Ibex" << std::endl
+            << "==================" << std::endl
+            << std::endl;
+
+  std::ofstream results("ibex_simple_system_batch.csv");
+  results << "index,elf,result,cycles" << std::endl;
+
+  bool all_finished = true;
+  unsigned long run_start_time = 0;
+
+  auto prepare_run = [&](unsigned int i) {
+    std::cout << std::endl
+              << "Running " << _batch_elfs[i] << " (" << i + 1 << "/"
+              << _batch_elfs.size() << ")" << std::endl;
+
+    // The reset doesn't clear memory. Zero it so each program starts from the
+    // same memory contents as a run of its own, rather than seeing what the
+    // previous program left outside of its ELF file.
+    try {
+      _ram.Write(0, std::vector<uint8_t>(_ram.GetSizeBytes(), 0));
+      _memutil.GetUnderlying()->LoadFileToNamedMem(false, "ram",
+                                                   _batch_elfs[i],
+                                                   kMemImageElf);
+    } catch (const std::exception &err) {
+      std::cerr << "ERROR: " << err.what() << std::endl;
+      return false;
+    }
+
+    run_start_time = simctrl.GetTime();
+    return true;
+  };
+
+  auto finish_run = [&](unsigned int i) {
+    // Programs finish by writing to the simulator control peripheral, which
+    // calls $finish(). Anything else means the run timed out or was stopped.
+    const char *result = !simctrl.WasSimulationSuccessful() ? "failed"
+                         : Verilated::gotFinish()           ? "finished"
+                                                            : "timeout";
+    all_finished &= (result == std::string("finished"));
+
+    std::cout << "Result: " << result << std::endl;
+    results << i << "," << _batch_elfs[i] << "," << result << ","
+            << (simctrl.GetTime() - run_start_time) / 2 << std::endl;
+
+    // See Finish() for why the scope is set
+    svSetScope(svGetScopeFromName("TOP.ibex_simple_system"));
+
+    std::ofstream pcount_csv("ibex_simple_system_pcount." + std::to_string(i) +
+                             ".csv");
+    pcount_csv << ibex_pcount_string(true);
+  };
+
+  simctrl.RunSimulations(_batch_elfs.size(), prepare_run, finish_run);
+
+  return all_finished && simctrl.WasSimulationSuccessful();
+}
+
+bool SimpleSystem::RunSeeds() {
+  VerilatorSimCtrl &simctrl = VerilatorSimCtrl::GetInstance();
+
+  unsigned int jobs = _seed_jobs;
+  if (!jobs) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = num_cpus > 0 ? num_cpus : 1;
+  }
+
+  std::cout << "Running " << _num_seeds << " seeds from " << _first_seed
+            << ", " << jobs << " at a time" << std::endl;
+
+  auto prepare_run = [this](unsigned int i) {
+    uint32_t seed = _first_seed + i;
+
+    // Each seed gets its own directory for the log, trace and counter files
+    // the simulation writes, its output goes there too
+    std::string dir = "seed_" + std::to_string(seed);
+    if (((mkdir(dir.c_str(), 0777) != 0) && (errno != EEXIST)) ||
+        (chdir(dir.c_str()) != 0)) {
+      std::cerr << "ERROR: Could not use directory " << dir << std::endl;
+      return false;
+    }
+
+    if (!freopen("simulation.log", "w", stdout) ||
+        (dup2(fileno(stdout), STDERR_FILENO) < 0)) {
+      return false;
+    }
+
+    std::cout << "Simulation of Ibex with seed " << seed << std::endl
+              << "==================" << std::endl
+              << std::endl;
+
+    std::vector<uint8_t> seed_word = {
+        uint8_t(seed), uint8_t(seed >> 8), uint8_t(seed >> 16),
+        uint8_t(seed >> 24)};
+    try {
+      _ram.Write((_seed_addr - kRAM_BaseAddr) / 4, seed_word);
+    } catch (const std::exception &err) {
+      std::cerr << "ERROR: " << err.what() << std::endl;
+      return false;
+    }
+
+    return true;
+  };
+
+  auto finish_run = [this](unsigned int) { return Finish(); };
+
+  std::vector<bool> results = simctrl.RunSimulationsForked(
+      _num_seeds, jobs, prepare_run, finish_run);
+
+  std::ofstream seeds_csv("ibex_simple_system_seeds.csv");
+  seeds_csv << "seed,directory,result" << std::endl;
+
+  unsigned int num_failed = 0;
+  for (unsigned int i = 0; i < results.size(); ++i) {
+    uint32_t seed = _first_seed + i;
+    const char *result = results[i] ? "passed" : "failed";
+
+    seeds_csv << seed << ",seed_" << seed << "," << result << std::endl;
+    if (!results[i]) {
+      std::cout << "Seed " << seed << " failed, see seed_" << seed
+                << "/simulation.log" << std::endl;
+      ++num_failed;
+    }
+  }
+
+  std::cout << results.size() - num_failed << " of " << results.size()
+            << " seeds passed" << std::endl;
+
+  return num_failed == 0;
+}
+
 void SimpleSystem::Run() {
   VerilatorSimCtrl &simctrl = VerilatorSimCtrl::GetInstance();
 
@@ -91,6 +409,11 @@ void SimpleSystem::Run() {
 bool SimpleSystem::Finish() {
   VerilatorSimCtrl &simctrl = VerilatorSimCtrl::GetInstance();
 
+  // Dump the state whatever the result, it's most useful after a failure
+  if (!_arch_state_file.empty()) {
+    DumpArchState();
+  }
+
   if (!simctrl.WasSimulationSuccessful()) {
     return false;
   }
@@ -109,3 +432,26 @@ bool SimpleSystem::Finish() {
 
   return true;
 }
+
+void SimpleSystem::DumpArchState() {
+  ArchState state;
+  try {
+    state.ReadFromRtl(kIbexTopScope);
+  } catch (const std::exception &err) {
+    std::cerr << "ERROR: Reading architectural state: " << err.what()
+              << std::endl;
+    return;
+  }
+
+  std::ofstream state_file(_arch_state_file);
+  state.Write(state_file);
+  if (!state_file) {
+    std::cerr << "ERROR: Could not write architectural state to "
+              << _arch_state_file << std::endl;
+  }
+}
+
+// Called from the design to start tracing, see +trace_start_pc
+extern "C" void simple_system_trace_start() {
+  VerilatorSimCtrl::GetInstance().TriggerTraceStart();
+}
@@ -2,6 +2,9 @@
 // Licensed under the Apache License, Version 2.0, see LICENSE for details.
 // SPDX-License-Identifier: Apache-2.0
 
+#include <string>
+#include <vector>
+
 #include "verilated_toplevel.h"
 #include "verilator_memutil.h"
 
@@ -9,6 +12,9 @@ class SimpleSystem {
  public:
   static constexpr uint32_t kRAM_BaseAddr = 0x100000u;
   static constexpr uint32_t kRAM_SizeBytes = 0x100000u;
+  // Scope of the ibex_top instance, for the architectural state backdoors
+  static constexpr const char *kIbexTopScope =
+      "TOP.ibex_simple_system.u_top.u_ibex_top";
 
   SimpleSystem(const char *ram_hier_path, int ram_size_words);
   virtual ~SimpleSystem() {}
@@ -22,8 +28,29 @@ class SimpleSystem {
   ibex_simple_system _top;
   VerilatorMemUtil _memutil;
   MemArea _ram;
+  // ELF files to run one after another, see --batch
+  std::vector<std::string> _batch_elfs;
+  // Seeds to run in parallel processes and where to write them, see --seeds
+  unsigned int _num_seeds;
+  uint32_t _first_seed;
+  uint32_t _seed_addr;
+  unsigned int _seed_jobs;
+  // File to write the architectural state to at the end, see --arch-state-dump
+  std::string _arch_state_file;
 
   virtual int Setup(int argc, char **argv, bool &exit_app);
   virtual void Run();
   virtual bool Finish();
+
+  bool ParseSimpleSystemArgs(int argc, char **argv, bool &exit_app);
+  void DumpArchState();
+  bool ReadBatchFile(const std::string &batch_file);
+
+  // Run every program of the batch on the same model, writing a result for
+  // each. Returns false if any program failed or didn't finish.
+  bool RunBatch();
+
+  // Run the loaded program once for each seed, forking a process for each
+  // run. Returns false if any seed failed.
+  bool RunSeeds();
 };
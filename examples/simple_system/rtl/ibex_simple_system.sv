@@ -350,6 +350,27 @@ module ibex_simple_system (
       .timer_intr_o   (timer_irq)
     );
 
+`ifdef VERILATOR
+  // Start waveform tracing when the instruction at the PC given by the trace_start_pc plusarg
+  // retires (e.g. +trace_start_pc=100080). Combine with --trace-window to only trace a window of
+  // cycles from that point.
+  import "DPI-C" function void simple_system_trace_start();
+
+  logic [31:0] trace_start_pc;
+  bit          trace_start_pc_en;
+
+  initial begin
+    trace_start_pc_en = $value$plusargs("trace_start_pc=%h", trace_start_pc);
+  end
+
+  always @(posedge clk_sys) begin
+    if (trace_start_pc_en && u_top.rvfi_valid && (u_top.rvfi_pc_rdata == trace_start_pc)) begin
+      simple_system_trace_start();
+      trace_start_pc_en = 1'b0;
+    end
+  end
+`endif
+
   export "DPI-C" function mhpmcounter_num;
 
   function automatic int unsigned mhpmcounter_num();
@@ -1673,6 +1673,181 @@ module ibex_cs_registers import ibex_pkg::*; #(
   assign csr_shadow_err_o =
     mstatus_err | mtvec_err | pmp_csr_err | cpuctrlsts_part_err | cpuctrlsts_ic_scr_key_err;
 
+`ifdef VERILATOR
+  /////////////////////
+  // Backdoor access //
+  /////////////////////
+
+  // Backdoor access to the privilege level and key CSRs, used to save and restore architectural
+  // state from C++ (see dv/verilator/arch_state). CSR values use the architectural layout. Writes
+  // take effect immediately so must be made between clock edges. They are legalised as a software
+  // write would be, but can also set state software can't write (e.g. dcsr.cause). PMP CSRs (see
+  // ibex_pmp_backdoor_config below) and the HPM counters aren't supported, nor are shadow copies of
+  // CSRs. Other simulators don't allow flops written by an always_ff to be written here too, so
+  // this is only provided for Verilator.
+  // The functions return 1 on success and 0 for an unsupported CSR or value.
+  export "DPI-C" function ibex_csr_backdoor_read;
+
+  function automatic int ibex_csr_backdoor_read(input int unsigned csr_num,
+                                                output int unsigned val);
+    val = '0;
+
+    if (csr_num > 32'hFFF) begin
+      return 0;
+    end
+
+    case (csr_num_e'(csr_num[11:0]))
+      CSR_MSTATUS: begin
+        val[CSR_MSTATUS_MIE_BIT]                              = mstatus_q.mie;
+        val[CSR_MSTATUS_MPIE_BIT]                             = mstatus_q.mpie;
+        val[CSR_MSTATUS_MPP_BIT_HIGH:CSR_MSTATUS_MPP_BIT_LOW] = mstatus_q.mpp;
+        val[CSR_MSTATUS_MPRV_BIT]                             = mstatus_q.mprv;
+        val[CSR_MSTATUS_TW_BIT]                               = mstatus_q.tw;
+      end
+      CSR_MIE: begin
+        val[CSR_MSIX_BIT]                       = mie_q.irq_software;
+        val[CSR_MTIX_BIT]                       = mie_q.irq_timer;
+        val[CSR_MEIX_BIT]                       = mie_q.irq_external;
+        val[CSR_MFIX_BIT_HIGH:CSR_MFIX_BIT_LOW] = mie_q.irq_fast;
+      end
+      CSR_MTVEC:         val = mtvec_q;
+      CSR_MSCRATCH:      val = mscratch_q;
+      CSR_MEPC:          val = mepc_q;
+      CSR_MCAUSE:        val = {mcause_q.irq_ext | mcause_q.irq_int,
+                                mcause_q.irq_int ? {26{1'b1}} : 26'b0,
+                                mcause_q.lower_cause[4:0]};
+      CSR_MTVAL:         val = mtval_q;
+      CSR_MCOUNTINHIBIT: val = mcountinhibit;
+      CSR_MCYCLE:        val = mhpmcounter[0][31:0];
+      CSR_MCYCLEH:       val = mhpmcounter[0][63:32];
+      CSR_MINSTRET:      val = minstret_raw[31:0];
+      CSR_MINSTRETH:     val = minstret_raw[63:32];
+      CSR_CPUCTRLSTS:    val = {{32 - $bits(cpu_ctrl_sts_part_t) - 1 {1'b0}},
+                                cpuctrlsts_ic_scr_key_valid_q,
+                                cpuctrlsts_part_q};
+      CSR_DCSR:          val = dcsr_q;
+      CSR_DPC:           val = depc_q;
+      CSR_DSCRATCH0:     val = dscratch0_q;
+      CSR_DSCRATCH1:     val = dscratch1_q;
+      default:           return 0;
+    endcase
+
+    return 1;
+  endfunction
+
+  export "DPI-C" function ibex_csr_backdoor_write;
+
+  function automatic int ibex_csr_backdoor_write(input int unsigned csr_num,
+                                                 input int unsigned val);
+    status_t            mstatus;
+    dcsr_t              dcsr;
+    cpu_ctrl_sts_part_t cpuctrlsts;
+
+    if ((csr_num > 32'hFFF) || ShadowCSR) begin
+      return 0;
+    end
+
+    case (csr_num_e'(csr_num[11:0]))
+      CSR_MSTATUS: begin
+        mstatus = '{
+            mie:  val[CSR_MSTATUS_MIE_BIT],
+            mpie: val[CSR_MSTATUS_MPIE_BIT],
+            mpp:  priv_lvl_e'(val[CSR_MSTATUS_MPP_BIT_HIGH:CSR_MSTATUS_MPP_BIT_LOW]),
+            mprv: val[CSR_MSTATUS_MPRV_BIT],
+            tw:   val[CSR_MSTATUS_TW_BIT]
+        };
+        if ((mstatus.mpp != PRIV_LVL_M) && (mstatus.mpp != PRIV_LVL_U)) begin
+          mstatus.mpp = PRIV_LVL_U;
+        end
+        u_mstatus_csr.rdata_q = mstatus;
+      end
+      CSR_MIE: begin
+        u_mie_csr.rdata_q = '{
+            irq_software: val[CSR_MSIX_BIT],
+            irq_timer:    val[CSR_MTIX_BIT],
+            irq_external: val[CSR_MEIX_BIT],
+            irq_fast:     val[CSR_MFIX_BIT_HIGH:CSR_MFIX_BIT_LOW]
+        };
+      end
+      CSR_MTVEC:         u_mtvec_csr.rdata_q = {val[31:8], 6'b0, 2'b01};
+      CSR_MSCRATCH:      u_mscratch_csr.rdata_q = val;
+      CSR_MEPC:          u_mepc_csr.rdata_q = {val[31:1], 1'b0};
+      CSR_MCAUSE: begin
+        u_mcause_csr.rdata_q = '{
+            irq_ext:     val[31:30] == 2'b10,
+            irq_int:     val[31:30] == 2'b11,
+            lower_cause: val[4:0]
+        };
+      end
+      CSR_MTVAL:         u_mtval_csr.rdata_q = val;
+      CSR_MCOUNTINHIBIT: mcountinhibit_q = {val[MHPMCounterNum+2:2], 1'b0, val[0]};
+      CSR_MCYCLE:        mcycle_counter_i.counter_q[31:0] = val;
+      CSR_MCYCLEH:       mcycle_counter_i.counter_q[63:32] = val;
+      CSR_MINSTRET:      minstret_counter_i.counter_q[31:0] = val;
+      CSR_MINSTRETH:     minstret_counter_i.counter_q[63:32] = val;
+      CSR_CPUCTRLSTS: begin
+        // The ICache scramble key valid bit is sampled from the top-level every cycle so isn't
+        // written
+        cpuctrlsts                   = cpu_ctrl_sts_part_t'(val[$bits(cpu_ctrl_sts_part_t)-1:0]);
+        cpuctrlsts.icache_enable    &= ICache;
+        cpuctrlsts.data_ind_timing  &= DataIndTiming;
+        cpuctrlsts.dummy_instr_en   &= DummyInstructions;
+        cpuctrlsts.dummy_instr_mask &= {3{DummyInstructions}};
+        u_cpuctrlsts_part_csr.rdata_q = cpuctrlsts;
+      end
+      CSR_DCSR: begin
+        dcsr           = val;
+        dcsr.xdebugver = XDEBUGVER_STD;
+        if ((dcsr.prv != PRIV_LVL_M) && (dcsr.prv != PRIV_LVL_U)) begin
+          dcsr.prv = PRIV_LVL_U;
+        end
+        dcsr.stepie    = 1'b0;
+        dcsr.nmip      = 1'b0;
+        dcsr.mprven    = 1'b0;
+        dcsr.stopcount = 1'b0;
+        dcsr.stoptime  = 1'b0;
+        dcsr.zero0     = 1'b0;
+        dcsr.zero1     = 1'b0;
+        dcsr.zero2     = 12'h0;
+        u_dcsr_csr.rdata_q = dcsr;
+      end
+      CSR_DPC:           u_depc_csr.rdata_q = {val[31:1], 1'b0};
+      CSR_DSCRATCH0:     u_dscratch0_csr.rdata_q = val;
+      CSR_DSCRATCH1:     u_dscratch1_csr.rdata_q = val;
+      default:           return 0;
+    endcase
+
+    return 1;
+  endfunction
+
+  // The PMP CSRs are accessed through the backdoor in each ibex_csr instance instead, this gives
+  // the configuration needed to find them and map their contents.
+  export "DPI-C" function ibex_pmp_backdoor_config;
+
+  function automatic void ibex_pmp_backdoor_config(output int unsigned num_regions,
+                                                   output int unsigned granularity);
+    num_regions = PMPEnable ? PMPNumRegions : 0;
+    granularity = PMPGranularity;
+  endfunction
+
+  export "DPI-C" function ibex_priv_backdoor_read;
+
+  function automatic int unsigned ibex_priv_backdoor_read();
+    return 32'(priv_lvl_q);
+  endfunction
+
+  export "DPI-C" function ibex_priv_backdoor_write;
+
+  function automatic int ibex_priv_backdoor_write(input int unsigned priv_lvl);
+    if ((priv_lvl != 32'(PRIV_LVL_M)) && (priv_lvl != 32'(PRIV_LVL_U))) begin
+      return 0;
+    end
+
+    priv_lvl_q = priv_lvl_e'(priv_lvl[1:0]);
+    return 1;
+  endfunction
+`endif
+
   ////////////////
   // Assertions //
   ////////////////
@@ -52,6 +52,31 @@ module ibex_csr #(
     assign rd_error_o = 1'b0;
   end
 
+`ifdef VERILATOR
+  // Backdoor access to the raw register contents, for CSRs the ibex_cs_registers backdoor can't
+  // reach (the PMP CSRs, which are instantiated in generate loops). Mapping to and from the
+  // architectural layout is left to the caller (see dv/verilator/arch_state). Writes take effect
+  // immediately so must be made between clock edges, and registers with a shadow copy can't be
+  // written. Only provided for Verilator, like the other backdoors. The write function returns 1 on
+  // success and 0 otherwise.
+  export "DPI-C" function ibex_csr_reg_backdoor_read;
+
+  function automatic int unsigned ibex_csr_reg_backdoor_read();
+    return 32'(rdata_q);
+  endfunction
+
+  export "DPI-C" function ibex_csr_reg_backdoor_write;
+
+  function automatic int ibex_csr_reg_backdoor_write(input int unsigned val);
+    if (ShadowCopy) begin
+      return 0;
+    end
+
+    rdata_q = val[Width-1:0];
+    return 1;
+  endfunction
+`endif
+
   `ASSERT_KNOWN(IbexCSREnValid, wr_en_i)
 
 endmodule
@@ -212,10 +212,33 @@ module ibex_if_stage import ibex_pkg::*; #(
   assign pc_mux_internal =
     (BranchPredictor && predict_branch_taken && !pc_set_i) ? PC_BP : pc_mux_i;
 
+  logic [31:0] boot_pc;
+
+`ifdef VERILATOR
+  // Backdoor override of the address fetched from on boot. Together with the register file and CSR
+  // backdoors this lets a simulation continue from a given architectural state without running
+  // code to load it (see dv/verilator/arch_state). The override isn't reset so it can be set before
+  // reset is released, and it applies to every boot until disabled again. Only provided for
+  // Verilator, like the other backdoors.
+  logic [31:0] boot_pc_backdoor    = '0;
+  logic        boot_pc_backdoor_en = 1'b0;
+
+  export "DPI-C" function ibex_boot_pc_backdoor_write;
+
+  function automatic void ibex_boot_pc_backdoor_write(input bit en, input int unsigned pc);
+    boot_pc_backdoor_en = en;
+    boot_pc_backdoor    = pc;
+  endfunction
+
+  assign boot_pc = boot_pc_backdoor_en ? boot_pc_backdoor : { boot_addr_i[31:8], 8'h80 };
+`else
+  assign boot_pc = { boot_addr_i[31:8], 8'h80 };
+`endif
+
   // fetch address selection mux
   always_comb begin : fetch_addr_mux
     unique case (pc_mux_internal)
-      PC_BOOT: fetch_addr_n = { boot_addr_i[31:8], 8'h80 };
+      PC_BOOT: fetch_addr_n = boot_pc;
       PC_JUMP: fetch_addr_n = branch_target_ex_i;
       PC_EXC:  fetch_addr_n = exc_pc;                       // set PC to exception handler
       PC_ERET: fetch_addr_n = csr_mepc_i;                   // restore PC when returning from EXC
@@ -43,6 +43,7 @@ module ibex_register_file_ff #(
   localparam int unsigned NUM_WORDS  = 2**ADDR_WIDTH;
 
   logic [DataWidth-1:0] rf_reg   [NUM_WORDS];
+  logic [DataWidth-1:0] rf_reg_q [1:NUM_WORDS-1];
   logic [NUM_WORDS-1:0] we_a_dec;
 
   always_comb begin : we_a_decoder
@@ -56,17 +57,15 @@ module ibex_register_file_ff #(
 
   // No flops for R0 as it's hard-wired to 0
   for (genvar i = 1; i < NUM_WORDS; i++) begin : g_rf_flops
-    logic [DataWidth-1:0] rf_reg_q;
-
     always_ff @(posedge clk_i or negedge rst_ni) begin
       if (!rst_ni) begin
-        rf_reg_q <= WordZeroVal;
+        rf_reg_q[i] <= WordZeroVal;
       end else if (we_a_dec[i]) begin
-        rf_reg_q <= wdata_a_i;
+        rf_reg_q[i] <= wdata_a_i;
       end
     end
 
-    assign rf_reg[i] = rf_reg_q;
+    assign rf_reg[i] = rf_reg_q[i];
   end
 
   // With dummy instructions enabled, R0 behaves as a real register but will always return 0 for
@@ -105,4 +104,31 @@ module ibex_register_file_ff #(
   logic unused_test_en;
   assign unused_test_en = test_en_i;
 
+`ifdef VERILATOR
+  // Backdoor access to the registers, used to save and restore architectural state from C++ (see
+  // dv/verilator/arch_state). Writes take effect immediately so must be made between clock edges.
+  // Register 0 can't be written and registers with integrity bits aren't supported. Other
+  // simulators don't allow flops written by an always_ff to be written here too, so this is only
+  // provided for Verilator. Both functions return 1 on success and 0 otherwise.
+  export "DPI-C" function ibex_rf_backdoor_read;
+
+  function automatic int ibex_rf_backdoor_read(input int unsigned index, output int unsigned val);
+    if ((DataWidth != 32) || (index >= NUM_WORDS)) begin
+      return 0;
+    end
+    val = 32'(rf_reg[index[ADDR_WIDTH-1:0]]);
+    return 1;
+  endfunction
+
+  export "DPI-C" function ibex_rf_backdoor_write;
+
+  function automatic int ibex_rf_backdoor_write(input int unsigned index, input int unsigned val);
+    if ((DataWidth != 32) || (index == 0) || (index >= NUM_WORDS)) begin
+      return 0;
+    end
+    rf_reg_q[index[ADDR_WIDTH-1:0]] = DataWidth'(val);
+    return 1;
+  endfunction
+`endif
+
 endmodule
@@ -80,4 +80,27 @@ module ibex_register_file_fpga #(
   logic unused_test_en;
   assign unused_test_en = test_en_i;
 
+`ifdef VERILATOR
+  // Backdoor access to the registers, matching the one in ibex_register_file_ff
+  export "DPI-C" function ibex_rf_backdoor_read;
+
+  function automatic int ibex_rf_backdoor_read(input int unsigned index, output int unsigned val);
+    if ((DataWidth != 32) || (index >= NUM_WORDS)) begin
+      return 0;
+    end
+    val = 32'(mem[index[ADDR_WIDTH-1:0]]);
+    return 1;
+  endfunction
+
+  export "DPI-C" function ibex_rf_backdoor_write;
+
+  function automatic int ibex_rf_backdoor_write(input int unsigned index, input int unsigned val);
+    if ((DataWidth != 32) || (index == 0) || (index >= NUM_WORDS)) begin
+      return 0;
+    end
+    mem[index[ADDR_WIDTH-1:0]] = DataWidth'(val);
+    return 1;
+  endfunction
+`endif
+
 endmodule
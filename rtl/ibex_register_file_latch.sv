@@ -165,4 +165,29 @@ module ibex_register_file_latch #(
   end
 `endif
 
+`ifdef VERILATOR
+  // Backdoor access to the registers, matching the one in ibex_register_file_ff. This register file
+  // can't be simulated with Verilator (see above) but provides the same exports so C++ code using
+  // them links against any configuration.
+  export "DPI-C" function ibex_rf_backdoor_read;
+
+  function automatic int ibex_rf_backdoor_read(input int unsigned index, output int unsigned val);
+    if ((DataWidth != 32) || (index >= NUM_WORDS)) begin
+      return 0;
+    end
+    val = 32'(mem[index[ADDR_WIDTH-1:0]]);
+    return 1;
+  endfunction
+
+  export "DPI-C" function ibex_rf_backdoor_write;
+
+  function automatic int ibex_rf_backdoor_write(input int unsigned index, input int unsigned val);
+    if ((DataWidth != 32) || (index == 0) || (index >= NUM_WORDS)) begin
+      return 0;
+    end
+    mem[index[ADDR_WIDTH-1:0]] = DataWidth'(val);
+    return 1;
+  endfunction
+`endif
+
 endmodule
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+
+# Copyright lowRISC contributors.
+# Licensed under the Apache License, Version 2.0, see LICENSE for details.
+# SPDX-License-Identifier: Apache-2.0
+
+'''Measure how the Simple System Verilator simulation scales with threads.
+
+Builds the single-threaded Simple System simulation (the 'sim' target) and a
+multithreaded one (the 'sim_mt' target) for each requested thread count, runs
+a benchmark binary (CoreMark by default) on each and reports the simulation
+speed in cycles/s.
+'''
+
+import argparse
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+import tempfile
+from typing import Dict, List, Optional
+
+_IBEX_ROOT = os.path.normpath(os.path.join(os.path.dirname(__file__), '..'))
+_CORE_NAME = 'lowrisc:ibex:ibex_simple_system'
+_SIM_BINARY = 'Vibex_simple_system'
+_DEFAULT_ELF = os.path.join('examples', 'sw', 'benchmarks', 'coremark',
+                            'coremark.elf')
+
+_SPEED_RE = re.compile(r'^Simulation speed:\s+([0-9.e+]+) cycles/s',
+                       re.MULTILINE)
+
+
+def fusesoc_opts(config: str) -> List[str]:
+    '''Get the FuseSoC options for an Ibex configuration'''
+    out = subprocess.run([os.path.join(_IBEX_ROOT, 'util', 'ibex_config.py'),
+                          config, 'fusesoc_opts'],
+                         check=True, stdout=subprocess.PIPE,
+                         universal_newlines=True).stdout
+    return shlex.split(out)
+
+
+def build(target: str, build_root: str, config_opts: List[str],
+          threads: Optional[int]) -> str:
+    '''Build a Simple System simulation, returning the path to the binary'''
+    env = dict(os.environ)
+    if threads is not None:
+        env['VERILATOR_THREADS'] = str(threads)
+
+    cmd = (['fusesoc', '--cores-root=' + _IBEX_ROOT, 'run',
+            '--target=' + target, '--setup', '--build',
+            '--build-root', build_root, _CORE_NAME] + config_opts)
+
+    print('Building {} ({})'.format(
+        target, 'unthreaded' if threads is None else
+        '{} threads'.format(threads)), flush=True)
+    subprocess.run(cmd, check=True, env=env, stdout=subprocess.DEVNULL)
+
+    return os.path.join(build_root, target + '-verilator', _SIM_BINARY)
+
+
+def run(binary: str, elf: str, runs: int) -> float:
+    '''Run a simulation `runs` times, returning the best speed in cycles/s'''
+    speeds = []
+
+    for _ in range(runs):
+        # The simulation writes its logs to the current directory
+        with tempfile.TemporaryDirectory() as run_dir:
+            out = subprocess.run([binary, '--meminit=ram,' + elf],
+                                 check=True, cwd=run_dir,
+                                 stdout=subprocess.PIPE,
+                                 universal_newlines=True).stdout
+
+        match = _SPEED_RE.search(out)
+        if match is None:
+            raise RuntimeError('No simulation speed reported by ' + binary)
+
+        speeds.append(float(match.group(1)))
+
+    return max(speeds)
+
+
+def main() -> int:
+    argparser = argparse.ArgumentParser(description=__doc__)
+    argparser.add_argument('--config', default='maxperf-pmp-bmfull',
+                           help=('Ibex configuration to build (see '
+                                 'ibex_configs.yaml)'))
+    argparser.add_argument('--threads', default='1,2,4,8',
+                           help='Comma separated list of thread counts')
+    argparser.add_argument('--elf', default=_DEFAULT_ELF,
+                           help='Binary to run, defaults to CoreMark')
+    argparser.add_argument('--runs', type=int, default=3,
+                           help=('Number of times to run each simulation, '
+                                 'the best speed is reported'))
+    argparser.add_argument('--build-root',
+                           default=os.path.join('build', 'thread_scaling'),
+                           help='Directory to build simulations in')
+    argparser.add_argument('--json',
+                           help='Also write the results to this JSON file')
+    args = argparser.parse_args()
+
+    thread_counts = [int(t) for t in args.threads.split(',')]
+    elf = os.path.abspath(args.elf)
+    if not os.path.exists(elf):
+        print('{} not found, build it first (see '
+              'examples/sw/benchmarks/README.md)'.format(args.elf),
+              file=sys.stderr)
+        return 1
+
+    config_opts = fusesoc_opts(args.config)
+    build_root = os.path.abspath(args.build_root)
+
+    # The unthreaded model is the baseline threaded models must beat
+    binaries = {'sim': build('sim', os.path.join(build_root, 'sim'),
+                             config_opts, None)}
+    for threads in thread_counts:
+        binaries['sim_mt-{}'.format(threads)] = build(
+            'sim_mt', os.path.join(build_root, 'mt{}'.format(threads)),
+            config_opts, threads)
+
+    results = {}  # type: Dict[str, float]
+    for name, binary in binaries.items():
+        print('Running {}'.format(name), flush=True)
+        results[name] = run(binary, elf, args.runs)
+
+    baseline = results['sim']
+    print()
+    print('{:<14}{:>16}{:>10}'.format('Build', 'cycles/s', 'speedup'))
+    for name, speed in results.items():
+        print('{:<14}{:>16.0f}{:>9.2f}x'.format(name, speed, speed / baseline))
+
+    if args.json:
+        with open(args.json, 'w') as json_file:
+            json.dump({'config': args.config,
+                       'elf': elf,
+                       'cycles_per_second': results}, json_file, indent=2)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())